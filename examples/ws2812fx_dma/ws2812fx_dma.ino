@@ -54,8 +54,9 @@ void setup() {
   strip.Begin();
   strip.Show();
 
-  // set the custom show function
-  ws2812fx.setCustomShow(myCustomShow);
+  // set the custom show function. NeoPixelBus sends the pixels in the background, so
+  // also pass a function that tells WS2812FX when the previous frame has been sent.
+  ws2812fx.setCustomShow(myCustomShow, myCustomShowBusy);
 
   ws2812fx.setBrightness(255);
   const uint32_t colors[] = {RED, BLACK, BLACK};
@@ -69,12 +70,14 @@ void loop() {
 }
 
 void myCustomShow(void) {
-  if(strip.CanShow()) {
-    // copy the WS2812FX pixel data to the NeoPixelBus instance
-    memcpy(strip.Pixels(), ws2812fx.getPixels(), strip.PixelsSize());
-    strip.Dirty();
-    strip.Show();
-  }
+  // copy the WS2812FX pixel data to the NeoPixelBus instance
+  memcpy(strip.Pixels(), ws2812fx.getPixels(), strip.PixelsSize());
+  strip.Dirty();
+  strip.Show();
+}
+
+boolean myCustomShowBusy(void) {
+  return !strip.CanShow();
 }
 
 
@@ -78,16 +78,20 @@ void loop() {
 // Need a separate function for each ws2812fx instance.
 void myCustomShow1(void) {
   uint8_t *pixels = ws2812fx1.getPixels();
-  // numBytes is one more then the size of the ws2812fx's *pixels array.
+  // WS2812 LEDs keep their color until new data arrives, so only send the pixels
+  // up to the last one that changed since the previous show().
+  // numBytes is one more then the size of that part of the *pixels array.
   // the extra byte is used by the driver to insert the LED reset pulse at the end.
-  uint16_t numBytes = ws2812fx1.getNumBytes() + 1;
+  uint16_t numBytes = (ws2812fx1.getDirtyStop() + 1) * ws2812fx1.getNumBytesPerPixel() + 1;
   rmt_write_sample(RMT_CHANNEL_0, pixels, numBytes, false); // channel 0
 }
 
 void myCustomShow2(void) {
   uint8_t *pixels = ws2812fx2.getPixels();
-  // numBytes is one more then the size of the *pixels array.
+  // WS2812 LEDs keep their color until new data arrives, so only send the pixels
+  // up to the last one that changed since the previous show().
+  // numBytes is one more then the size of that part of the *pixels array.
   // the extra byte is used by the driver to insert the LED reset pulse at the end.
-  uint16_t numBytes = ws2812fx2.getNumBytes() + 1;
+  uint16_t numBytes = (ws2812fx2.getDirtyStop() + 1) * ws2812fx2.getNumBytesPerPixel() + 1;
   rmt_write_sample(RMT_CHANNEL_1, pixels, numBytes, false); // channel 1
 }
@@ -0,0 +1,205 @@
+/*
+  mode_bench.cpp - per-mode render cost table for the WS2812FX host build.
+
+  Runs every builtin mode and every effect in src/custom through service(),
+  driven by a VirtualClock so each call renders exactly one frame, and prints
+  ns/frame, ns/pixel, setPixelColor() calls per frame and the fraction of
+  frames actually sent by show() for several strip lengths.
+
+  usage: mode_bench [-d] [length ...]   (default: 30 300 3000 30000)
+    -d  enable duplicate frame suppression (setSuppressDuplicates())
+
+  LICENSE
+
+  The MIT License (MIT)
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include <WS2812FX.h>
+
+#include <stdio.h>
+#include <vector>
+#include <chrono>
+
+// the custom effects reference this global instance
+WS2812FX ws2812fx;
+
+#include "custom/BlockDissolve.h"
+#include "custom/DualLarson.h"
+#include "custom/Fillerup.h"
+#include "custom/Heartbeat.h"
+#include "custom/MultiComet.h"
+#include "custom/Oscillate.h"
+#include "custom/Popcorn.h"
+#include "custom/Rain.h"
+#include "custom/RainbowFireworks.h"
+#include "custom/RainbowLarson.h"
+#include "custom/RandomChase.h"
+#include "custom/TriFade.h"
+#include "custom/TwinkleFox.h"
+#include "custom/VUMeter.h"
+
+#define PIXEL_BUDGET 3000000UL // pixels rendered per mode and length
+#define MIN_FRAMES   20
+#define MAX_FRAMES   2000
+#define WARMUP_FRAMES 5
+
+typedef struct Custom_effect {
+  const char* name;
+  uint16_t (*fn)(void);
+} custom_effect;
+
+static const custom_effect customEffects[] = {
+  {"BlockDissolve",    blockDissolve},
+  {"DualLarson",       dualLarson},
+  {"Fillerup",         fillerup},
+  {"Heartbeat",        heartbeat},
+  {"MultiComet",       multiComet},
+  {"Oscillate",        oscillate},
+  {"Popcorn",          popcorn},
+  {"Rain",             rain},
+  {"RainbowFireworks", rainbowFireworks},
+  {"RainbowLarson",    rainbowLarson},
+  {"RandomChase",      randomChase},
+  {"TriFade",          triFade},
+  {"TwinkleFox",       twinkleFox},
+  {"VUMeter",          vuMeter}
+};
+
+typedef struct Result {
+  double ns_per_frame;
+  double ns_per_pixel;
+  double writes_per_frame;
+  double shows_per_frame;
+} result;
+
+static VirtualClock clk;
+static bool suppressDuplicates = false;
+
+/*
+ * Render 'frames' frames of mode 'm' on a strip of 'len' LEDs. The virtual
+ * clock is moved past the segment's next_time before every service() call,
+ * so each call renders exactly one frame.
+ */
+static result runMode(CRGB* leds, uint16_t len, uint8_t m, uint16_t (*custom)(void)) {
+  ws2812fx = WS2812FX(leds, len);
+  ws2812fx.setSegment(0, 0, len - 1, m, (const uint32_t[]){RED, BLUE, GREEN}, DEFAULT_SPEED, NO_OPTIONS);
+  if(custom != NULL) ws2812fx.setCustomMode(custom);
+  ws2812fx.setSuppressDuplicates(suppressDuplicates);
+
+  clk.set(0);
+  ws2812fx.start();
+
+  uint32_t frames = PIXEL_BUDGET / len;
+  frames = constrain(frames, MIN_FRAMES, MAX_FRAMES);
+
+  for(uint8_t i=0; i < WARMUP_FRAMES; i++) {
+    clk.set(ws2812fx.getSegmentRuntime(0)->next_time + 1);
+    ws2812fx.service();
+  }
+
+  ws2812fx.resetPixelWriteCount();
+  unsigned long shows = FastLED.getShowCount();
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for(uint32_t i=0; i < frames; i++) {
+    clk.set(ws2812fx.getSegmentRuntime(0)->next_time + 1);
+    ws2812fx.service();
+  }
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+  double ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+  result r;
+  r.ns_per_frame = ns / frames;
+  r.ns_per_pixel = r.ns_per_frame / len;
+  r.writes_per_frame = (double)ws2812fx.getPixelWriteCount() / frames;
+  r.shows_per_frame = (double)(FastLED.getShowCount() - shows) / frames;
+  return r;
+}
+
+static void printHeader(const std::vector<uint16_t>& lengths) {
+  printf("%-26s", "mode");
+  for(size_t i=0; i < lengths.size(); i++) {
+    char col[32];
+    snprintf(col, sizeof(col), "len=%u", lengths[i]);
+    printf(" | %-41s", col);
+  }
+  printf("\n%-26s", "");
+  for(size_t i=0; i < lengths.size(); i++) {
+    printf(" | %12s %8s %10s %8s", "ns/frame", "ns/px", "writes/fr", "shows/fr");
+  }
+  printf("\n");
+}
+
+static void printRow(const char* name, const std::vector<result>& results) {
+  printf("%-26s", name);
+  for(size_t i=0; i < results.size(); i++) {
+    printf(" | %12.0f %8.2f %10.1f %8.2f", results[i].ns_per_frame, results[i].ns_per_pixel,
+      results[i].writes_per_frame, results[i].shows_per_frame);
+  }
+  printf("\n");
+}
+
+int main(int argc, char* argv[]) {
+  std::vector<uint16_t> lengths;
+  for(int i=1; i < argc; i++) {
+    if(strcmp(argv[i], "-d") == 0) {
+      suppressDuplicates = true;
+      continue;
+    }
+    long len = atol(argv[i]);
+    if(len < 30 || len > 65535) {
+      fprintf(stderr, "invalid strip length '%s' (30-65535)\n", argv[i]);
+      return 1;
+    }
+    lengths.push_back((uint16_t)len);
+  }
+  if(lengths.empty()) {
+    lengths.push_back(30);
+    lengths.push_back(300);
+    lengths.push_back(3000);
+    lengths.push_back(30000);
+  }
+
+  uint16_t maxLen = 0;
+  for(size_t i=0; i < lengths.size(); i++) maxLen = max(maxLen, lengths[i]);
+  std::vector<CRGB> leds(maxLen);
+
+  setHostClock(&clk);
+  printHeader(lengths);
+
+  for(uint8_t m=0; m < FX_MODE_CUSTOM_0; m++) {
+    std::vector<result> results;
+    for(size_t i=0; i < lengths.size(); i++) {
+      results.push_back(runMode(leds.data(), lengths[i], m, NULL));
+    }
+    printRow((const char*)ws2812fx.getModeName(m), results);
+  }
+
+  for(size_t c=0; c < sizeof(customEffects)/sizeof(customEffects[0]); c++) {
+    std::vector<result> results;
+    for(size_t i=0; i < lengths.size(); i++) {
+      results.push_back(runMode(leds.data(), lengths[i], FX_MODE_CUSTOM_0, customEffects[c].fn));
+    }
+    printRow(customEffects[c].name, results);
+  }
+
+  setHostClock(NULL);
+  return 0;
+}
@@ -0,0 +1,81 @@
+/*
+  Arduino.cpp - minimal Arduino core shim for building WS2812FX on a host (Linux) machine.
+
+  LICENSE
+
+  The MIT License (MIT)
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include "Arduino.h"
+
+#include <chrono>
+#include <thread>
+
+/*
+ * Real-time clock, millis() counts from the first time the clock is read.
+ */
+class SteadyClock : public HostClock {
+  public:
+    SteadyClock(void) : _start(std::chrono::steady_clock::now()) {}
+    unsigned long millis(void) {
+      return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - _start).count();
+    }
+    void delay(unsigned long ms) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    }
+  private:
+    std::chrono::steady_clock::time_point _start;
+};
+
+static SteadyClock _steadyClock;
+static HostClock* _hostClock = &_steadyClock;
+
+void setHostClock(HostClock* clock) {
+  _hostClock = (clock == NULL) ? &_steadyClock : clock;
+}
+
+HostClock* getHostClock(void) {
+  return _hostClock;
+}
+
+unsigned long millis(void) {
+  return _hostClock->millis();
+}
+
+void delay(unsigned long ms) {
+  _hostClock->delay(ms);
+}
+
+// same semantics as the Arduino core: the upper bound is exclusive
+long random(long max) {
+  if(max <= 0) return 0;
+  return ::random() % max;
+}
+
+long random(long min, long max) {
+  if(min >= max) return min;
+  return random(max - min) + min;
+}
+
+void randomSeed(unsigned long seed) {
+  if(seed != 0) srandom(seed);
+}
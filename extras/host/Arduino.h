@@ -0,0 +1,113 @@
+/*
+  Arduino.h - minimal Arduino core shim for building WS2812FX on a host (Linux) machine.
+
+  Only the parts of the Arduino API used by the library and its custom effects
+  are provided. Time is read through a HostClock, which can be swapped for a
+  VirtualClock so the render loop can be driven headless and deterministically
+  (benchmarks, profiling with perf/cachegrind, etc.).
+
+  LICENSE
+
+  The MIT License (MIT)
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <type_traits>
+
+#define WS2812FX_HOST
+
+typedef bool    boolean;
+typedef uint8_t byte;
+
+// flash memory is just memory on the host
+#define PROGMEM
+#define PSTR(s) (s)
+#define pgm_read_byte(addr)  (*(const uint8_t*)(addr))
+#define pgm_read_word(addr)  (*(const uint16_t*)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t*)(addr))
+#define pgm_read_ptr(addr)   (*(void* const*)(addr))
+#define memcpy_P(dest, src, n) memcpy((dest), (src), (n))
+
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper*>(PSTR(s)))
+
+// binary constants (subset of Arduino's binary.h used by the library)
+#define B00000000 0
+#define B00000001 1
+#define B00000010 2
+#define B00000100 4
+#define B00000110 6
+#define B00001000 8
+#define B00010000 16
+#define B00100000 32
+#define B00110000 48
+#define B01000000 64
+#define B01010000 80
+#define B01100000 96
+#define B01110000 112
+#define B10000000 128
+
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+template<class T, class U>
+inline typename std::common_type<T, U>::type min(T a, U b) { return (a < b) ? a : b; }
+template<class T, class U>
+inline typename std::common_type<T, U>::type max(T a, U b) { return (a > b) ? a : b; }
+
+/*
+ * Time source used by millis() and delay(). The default clock follows the
+ * host's monotonic clock; install a VirtualClock to run without waiting.
+ */
+class HostClock {
+  public:
+    virtual ~HostClock() {}
+    virtual unsigned long millis(void) = 0;
+    virtual void delay(unsigned long ms) = 0;
+};
+
+class VirtualClock : public HostClock {
+  public:
+    VirtualClock(unsigned long start = 0) : _now(start) {}
+    unsigned long millis(void) { return _now; }
+    void delay(unsigned long ms) { _now += ms; } // delays complete instantly
+    void advance(unsigned long ms) { _now += ms; }
+    void set(unsigned long ms) { _now = ms; }
+  private:
+    unsigned long _now;
+};
+
+void       setHostClock(HostClock* clock); // NULL restores the real-time clock
+HostClock* getHostClock(void);
+
+unsigned long millis(void);
+void delay(unsigned long ms);
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+#endif
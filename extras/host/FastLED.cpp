@@ -0,0 +1,60 @@
+/*
+  FastLED.cpp - minimal FastLED shim for building WS2812FX on a host (Linux) machine.
+
+  LICENSE
+
+  The MIT License (MIT)
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include "FastLED.h"
+
+CFastLED FastLED;
+
+/*
+ * Same piecewise linear approximation as FastLED's sin8_C(), so effects
+ * produce identical output on the host and on the device.
+ */
+uint8_t sin8(uint8_t theta) {
+  static const uint8_t b_m16_interleave[] = { 0, 49, 49, 41, 90, 27, 117, 10 };
+
+  uint8_t offset = theta;
+  if(theta & 0x40) {
+    offset = (uint8_t)255 - offset;
+  }
+  offset &= 0x3F; // 0..63
+
+  uint8_t secoffset = offset & 0x0F; // 0..15
+  if(theta & 0x40) secoffset++;
+
+  uint8_t section = offset >> 4; // 0..3
+  uint8_t s2 = section * 2;
+  uint8_t b   = b_m16_interleave[s2];
+  uint8_t m16 = b_m16_interleave[s2 + 1];
+
+  uint8_t mx = (m16 * secoffset) >> 4;
+
+  int8_t y = mx + b;
+  if(theta & 0x80) y = -y;
+
+  y += 128;
+
+  return y;
+}
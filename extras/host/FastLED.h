@@ -0,0 +1,169 @@
+/*
+  FastLED.h - minimal FastLED shim for building WS2812FX on a host (Linux) machine.
+
+  Provides CRGB, sin8() and a FastLED controller object whose show() does not
+  drive any hardware. Frames pushed through FastLED.show() are only counted.
+  The LED controllers are mock outputs: they record their pin and color order
+  and count the frames and LEDs sent through them.
+
+  LICENSE
+
+  The MIT License (MIT)
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#ifndef FastLED_h
+#define FastLED_h
+
+#include "Arduino.h"
+
+struct CRGB {
+  union {
+    struct {
+      union { uint8_t r; uint8_t red;   };
+      union { uint8_t g; uint8_t green; };
+      union { uint8_t b; uint8_t blue;  };
+    };
+    uint8_t raw[3];
+  };
+
+  inline CRGB() {}
+  inline CRGB(uint8_t ir, uint8_t ig, uint8_t ib) : r(ir), g(ig), b(ib) {}
+  inline CRGB(uint32_t colorcode) : r((colorcode >> 16) & 0xFF), g((colorcode >> 8) & 0xFF), b(colorcode & 0xFF) {}
+
+  inline uint8_t& operator[] (uint8_t x) { return raw[x]; }
+
+  inline CRGB& operator= (const uint32_t colorcode) {
+    r = (colorcode >> 16) & 0xFF;
+    g = (colorcode >>  8) & 0xFF;
+    b = (colorcode >>  0) & 0xFF;
+    return *this;
+  }
+
+  inline CRGB& setRGB(uint8_t nr, uint8_t ng, uint8_t nb) {
+    r = nr;
+    g = ng;
+    b = nb;
+    return *this;
+  }
+
+  // packs the color as 0x00RRGGBB
+  inline operator uint32_t() const {
+    return ((uint32_t)r << 16) | ((uint32_t)g << 8) | (uint32_t)b;
+  }
+};
+
+enum EOrder { RGB = 0012, RBG = 0021, GRB = 0102, GBR = 0120, BRG = 0201, BGR = 0210 };
+
+// chipset placeholders, only used to select a controller at compile time
+template<uint8_t DATA_PIN, EOrder RGB_ORDER = GRB> class WS2812 {};
+template<uint8_t DATA_PIN, EOrder RGB_ORDER = GRB> class WS2811 {};
+template<uint8_t DATA_PIN, EOrder RGB_ORDER = GRB> class NEOPIXEL {};
+
+class CLEDController {
+  public:
+    CLEDController(void) : _leds(NULL), _numLeds(0), _next(NULL), _pin(0), _order(RGB),
+      _brightness(255), _showCount(0), _ledsSent(0) {}
+    CRGB* leds(void) { return _leds; }
+    int size(void) { return _numLeds; }
+    CLEDController& setLeds(CRGB* data, int nLeds) {
+      _leds = data;
+      _numLeds = nLeds;
+      return *this;
+    }
+
+    void showLeds(uint8_t brightness = 255) {
+      _brightness = brightness;
+      _showCount++;
+      _ledsSent += _numLeds;
+    }
+
+    // host only
+    uint8_t getPin(void) { return _pin; }
+    EOrder getColorOrder(void) { return _order; }
+    uint8_t getLastBrightness(void) { return _brightness; }
+    unsigned long getShowCount(void) { return _showCount; }
+    unsigned long getLedsSent(void) { return _ledsSent; }
+
+  private:
+    friend class CFastLED;
+    CRGB* _leds;
+    int _numLeds;
+    CLEDController* _next;
+    uint8_t _pin;
+    EOrder _order;
+    uint8_t _brightness;
+    unsigned long _showCount;
+    unsigned long _ledsSent;
+};
+
+class CFastLED {
+  public:
+    CFastLED(void) : _brightness(255), _showCount(0), _controllers(NULL) {}
+
+    template<template<uint8_t DATA_PIN, EOrder RGB_ORDER> class CHIPSET, uint8_t DATA_PIN, EOrder RGB_ORDER>
+    CLEDController& addLeds(struct CRGB* data, int nLedsOrOffset, int nLedsIfOffset = 0) {
+      CLEDController* c = new CLEDController();
+      c->_leds = (nLedsIfOffset > 0) ? data + nLedsOrOffset : data;
+      c->_numLeds = (nLedsIfOffset > 0) ? nLedsIfOffset : nLedsOrOffset;
+      c->_pin = DATA_PIN;
+      c->_order = RGB_ORDER;
+      CLEDController** tail = &_controllers; // keep the controllers in the order they were added
+      while(*tail != NULL) tail = &(*tail)->_next;
+      *tail = c;
+      return *c;
+    }
+
+    template<template<uint8_t DATA_PIN, EOrder RGB_ORDER> class CHIPSET, uint8_t DATA_PIN>
+    CLEDController& addLeds(struct CRGB* data, int nLedsOrOffset, int nLedsIfOffset = 0) {
+      return addLeds<CHIPSET, DATA_PIN, RGB>(data, nLedsOrOffset, nLedsIfOffset);
+    }
+
+    void setBrightness(uint8_t scale) { _brightness = scale; }
+    uint8_t getBrightness(void) { return _brightness; }
+
+    void show(void) {
+      _showCount++;
+      for(CLEDController* c = _controllers; c != NULL; c = c->_next) c->showLeds(_brightness);
+    }
+    unsigned long getShowCount(void) { return _showCount; } // host only
+
+    int count(void) {
+      int n = 0;
+      for(CLEDController* c = _controllers; c != NULL; c = c->_next) n++;
+      return n;
+    }
+    CLEDController& operator[](int x) {
+      CLEDController* c = _controllers;
+      while(x-- > 0 && c->_next != NULL) c = c->_next;
+      return *c;
+    }
+
+  private:
+    uint8_t _brightness;
+    unsigned long _showCount;
+    CLEDController* _controllers;
+};
+
+extern CFastLED FastLED;
+
+uint8_t sin8(uint8_t theta);
+
+#endif
@@ -0,0 +1,213 @@
+/*
+  command_queue.cpp - control change queue test for the WS2812FX host build.
+
+  Fills the queue from one thread to check the full result and the order
+  across the wraparound of its ring buffer, then has several producer threads
+  queue far more changes than the queue holds (and than its 16 bit positions
+  count) while service() applies them, and checks every producer's changes
+  arrive complete and in order. Run it under -DWS2812FX_SANITIZE=thread to
+  check the queue's memory ordering too. Last, scenes go through the queue:
+  an invalid one is refused, a valid one is installed whole by one service()
+  call, with SCENE_CLEAR and SCENE_KEEP_BRIGHTNESS doing what they say.
+
+  LICENSE
+
+  The MIT License (MIT)
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include "test.h"
+
+#include <thread>
+#include <atomic>
+
+#define NUM_LEDS     300
+#define PRODUCERS    4
+#define PER_PRODUCER 20000 // PRODUCERS * PER_PRODUCER > 65536, the queue positions wrap too
+
+static CRGB leds[NUM_LEDS];
+static VirtualClock clk;
+static WS2812FX ws2812fx(leds, NUM_LEDS);
+
+static WS2812FX::command speedCommand(uint8_t seg, uint16_t speed) {
+  WS2812FX::command c = WS2812FX::command();
+  c.type = CMD_SET_SPEED;
+  c.seg = seg;
+  c.speed = speed;
+  return c;
+}
+
+// one thread: a full queue refuses the next change, a batch is applied in order
+static void testFullAndWrap(void) {
+  uint16_t speed = 100;
+  for(uint8_t round=0; round < 5; round++) { // 5 queue lengths, the ring wraps around
+    for(uint16_t i=0; i < COMMAND_QUEUE_SIZE; i++) {
+      CHECK(ws2812fx.queueCommand(speedCommand(i % PRODUCERS, ++speed)));
+    }
+    CHECK(!ws2812fx.queueCommand(speedCommand(0, 1))); // full
+    ws2812fx.service();
+    // speeds only go up, so each segment holds the last of its changes if they were applied in order
+    for(uint8_t s=0; s < PRODUCERS; s++) {
+      uint16_t last = speed - ((speed - 100 - 1 - s) % PRODUCERS);
+      CHECK_EQUAL(ws2812fx.getSpeed(s), last);
+    }
+    CHECK(ws2812fx.queueCommand(speedCommand(0, speed))); // room again
+    ws2812fx.service();
+  }
+}
+
+// several producers, service() as the single consumer
+static void testProducers(void) {
+  for(uint8_t p=0; p < PRODUCERS; p++) {
+    ws2812fx.setSpeed(p, 100);
+  }
+  std::atomic<uint8_t> finished(0);
+  std::atomic<unsigned long> full(0);
+  std::thread producers[PRODUCERS];
+  for(uint8_t p=0; p < PRODUCERS; p++) {
+    producers[p] = std::thread([p, &finished, &full] {
+      for(uint16_t i=1; i <= PER_PRODUCER; i++) {
+        while(!ws2812fx.queueCommand(speedCommand(p, 100 + i))) {
+          full++;
+          std::this_thread::yield();
+        }
+      }
+      finished++;
+    });
+  }
+
+  uint16_t last[PRODUCERS] = {0};
+  boolean ordered = true;
+  for(;;) {
+    boolean done = finished == PRODUCERS; // everything is queued, one more service() applies the rest
+    ws2812fx.service();
+    clk.advance(1);
+    for(uint8_t p=0; p < PRODUCERS; p++) {
+      uint16_t speed = ws2812fx.getSpeed(p);
+      if(speed < last[p]) ordered = false;
+      last[p] = speed;
+    }
+    if(done) break;
+    std::this_thread::yield(); // let the producers run on a single core
+  }
+  for(uint8_t p=0; p < PRODUCERS; p++) {
+    producers[p].join();
+    CHECK_EQUAL(ws2812fx.getSpeed(p), 100 + PER_PRODUCER);
+  }
+  CHECK(ordered);
+  printf("queue full %lu times\n", (unsigned long)full);
+}
+
+static WS2812FX::scene_config scene;
+
+// three static segments on the first half of the strip
+static void prepareScene(uint8_t options) {
+  ws2812fx.getScene(&scene);
+  scene.num_segments = 3;
+  scene.brightness = 40;
+  scene.options = options;
+  for(uint8_t s=0; s < 3; s++) {
+    WS2812FX::segment seg = *ws2812fx.getSegment(0);
+    seg.start = s * 50;
+    seg.stop = s * 50 + 49;
+    seg.mode = FX_MODE_STATIC;
+    seg.colors[0] = BLUE;
+    scene.segments[s] = seg;
+  }
+}
+
+// refills the strip with the red starting setup at full brightness, returns the last LED's color
+static uint32_t resetStrip(void) {
+  ws2812fx.setNumSegments(PRODUCERS);
+  for(uint8_t s=0; s < PRODUCERS; s++) {
+    ws2812fx.setSegment(s, s*75, s*75+74, FX_MODE_STATIC, RED, 100, (uint8_t)NO_OPTIONS);
+  }
+  ws2812fx.setBrightness(255);
+  ws2812fx.trigger();
+  ws2812fx.service();
+  uint32_t red = ws2812fx.getPixelColor(NUM_LEDS - 1);
+  CHECK(red != BLACK);
+  return red;
+}
+
+static void testScenes(void) {
+  uint32_t red = resetStrip();
+
+  prepareScene(NO_OPTIONS);
+  scene.segments[2].stop = NUM_LEDS; // past the end of the strip
+  CHECK(!ws2812fx.isValidScene(&scene));
+  CHECK(!ws2812fx.setScene(&scene));
+  scene.segments[2].stop = 149;
+  scene.segments[1].mode = ws2812fx.getModeCount(); // no such mode
+  CHECK(!ws2812fx.setScene(&scene));
+  scene.num_segments = 0;
+  CHECK(!ws2812fx.setScene(&scene));
+  CHECK(!ws2812fx.isScenePending());
+  CHECK_EQUAL(ws2812fx.getNumSegments(), PRODUCERS);
+
+  // a valid scene: copied, so the caller can edit it right away, one scene waits at a time
+  prepareScene(NO_OPTIONS);
+  CHECK(ws2812fx.setScene(&scene));
+  CHECK(ws2812fx.isScenePending());
+  CHECK(!ws2812fx.setScene(&scene));
+  scene.segments[0].colors[0] = GREEN;
+  clk.advance(1);
+  unsigned long shows = FastLED.getShowCount();
+  ws2812fx.service();
+  CHECK(!ws2812fx.isScenePending());
+  CHECK_EQUAL(FastLED.getShowCount(), shows + 1); // one show for the whole scene and its brightness
+  CHECK_EQUAL(ws2812fx.getNumSegments(), 3);
+  for(uint8_t s=0; s < 3; s++) {
+    CHECK(ws2812fx.isFrame(s)); // every segment rendered by that one service() call
+  }
+  CHECK_EQUAL(ws2812fx.getPixelColor(0), BLUE);
+  CHECK_EQUAL(ws2812fx.getPixelColor(149), BLUE);
+  CHECK_EQUAL(ws2812fx.getPixelColor(NUM_LEDS - 1), red); // not covered by the scene, left alone
+  CHECK_EQUAL(ws2812fx.getBrightness(), 40);
+  CHECK_EQUAL(FastLED.getBrightness(), 40);
+
+  // SCENE_CLEAR blacks out what the scene doesn't cover, SCENE_KEEP_BRIGHTNESS keeps the brightness
+  CHECK_EQUAL(resetStrip(), red);
+  prepareScene(SCENE_CLEAR | SCENE_KEEP_BRIGHTNESS);
+  CHECK(ws2812fx.setScene(&scene));
+  clk.advance(1);
+  shows = FastLED.getShowCount();
+  ws2812fx.service();
+  CHECK_EQUAL(FastLED.getShowCount(), shows + 1);
+  CHECK_EQUAL(ws2812fx.getPixelColor(0), BLUE);
+  CHECK_EQUAL(ws2812fx.getPixelColor(NUM_LEDS - 1), BLACK);
+  CHECK_EQUAL(ws2812fx.getBrightness(), 255);
+}
+
+int main() {
+  setHostClock(&clk);
+  ws2812fx.init();
+  ws2812fx.setNumSegments(PRODUCERS);
+  for(uint8_t s=0; s < PRODUCERS; s++) {
+    ws2812fx.setSegment(s, s*75, s*75+74, FX_MODE_STATIC, RED, 100, (uint8_t)NO_OPTIONS);
+  }
+  ws2812fx.start();
+
+  testFullAndWrap();
+  testProducers();
+  testScenes();
+
+  return TEST_RESULT();
+}
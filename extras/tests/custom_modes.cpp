@@ -0,0 +1,127 @@
+/*
+  custom_modes.cpp - custom mode registry test for the WS2812FX host build.
+
+  Registers more custom modes than the template's MaxCustomModes slots, plain
+  and timed ones, each with its own context pointer, and checks that every
+  mode id runs its own function with its own context, also in a copy of the
+  instance.
+
+  LICENSE
+
+  The MIT License (MIT)
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include "test.h"
+
+#include <string.h>
+
+#define NUM_LEDS  60
+#define NUM_MODES 10 // more than the default MaxCustomModes
+
+static CRGB leds[NUM_LEDS];
+static VirtualClock clk;
+
+typedef struct Effect_state {
+  uint32_t calls;
+  uint32_t elapsed; // total ms passed to a timed effect
+  uint16_t phase;
+} effect_state;
+
+static effect_state states[NUM_MODES];
+static uint16_t legacyCalls = 0;
+
+static uint16_t plainEffect(void* context) {
+  ((effect_state*)context)->calls++;
+  return 20;
+}
+
+static void timedEffect(void* context, uint16_t elapsed, uint16_t phase) {
+  effect_state* s = (effect_state*)context;
+  s->calls++;
+  s->elapsed += elapsed;
+  s->phase = phase;
+}
+
+static uint16_t legacyEffect(void) {
+  legacyCalls++;
+  return 20;
+}
+
+int main() {
+  setHostClock(&clk);
+  WS2812FX ws2812fx(leds, NUM_LEDS);
+  ws2812fx.init();
+
+  uint8_t modes[NUM_MODES];
+  for(uint8_t i=0; i < NUM_MODES; i++) {
+    modes[i] = (i & 1) ?
+      ws2812fx.setCustomMode(F("Timed"), timedEffect, &states[i]) :
+      ws2812fx.setCustomMode(F("Plain"), plainEffect, &states[i]);
+    CHECK_EQUAL(modes[i], FX_MODE_CUSTOM_0 + i);
+    CHECK_EQUAL(ws2812fx.getModeFlags(modes[i]) & MODE_TIMED, (i & 1) ? MODE_TIMED : 0);
+  }
+  CHECK_EQUAL(ws2812fx.getModeCount(), FX_MODE_CUSTOM_0 + NUM_MODES);
+  CHECK(strcmp((const char*)ws2812fx.getModeName(modes[1]), "Timed") == 0);
+
+  // one LED per segment, every custom mode once
+  ws2812fx.setNumSegments(NUM_MODES);
+  for(uint8_t i=0; i < NUM_MODES; i++) {
+    ws2812fx.setSegment(i, i, i, modes[i], RED, 1000, (uint8_t)NO_OPTIONS);
+  }
+  clk.set(0);
+  ws2812fx.start();
+  for(uint16_t t=0; t < 1000; t++) {
+    ws2812fx.service();
+    clk.advance(1);
+  }
+  for(uint8_t i=0; i < NUM_MODES; i++) {
+    CHECK(states[i].calls > 10);
+    if(i & 1) { // timed modes get the time that passed, a whole speed cycle brings the phase back round
+      CHECK(states[i].elapsed > 900 && states[i].elapsed <= 1000);
+      CHECK(states[i].phase > 60000 || states[i].phase < 5000);
+    } else {
+      CHECK_EQUAL(states[i].elapsed, 0);
+    }
+  }
+
+  // a copy keeps the registry, the modes still get their own context
+  WS2812FX copy = ws2812fx;
+  CHECK_EQUAL(copy.getModeCount(), FX_MODE_CUSTOM_0 + NUM_MODES);
+  uint32_t before = states[NUM_MODES - 1].calls;
+  for(uint16_t t=0; t < 100; t++) {
+    copy.service();
+    clk.advance(1);
+  }
+  CHECK(states[NUM_MODES - 1].calls > before);
+
+  // the old style custom mode goes in the first slot
+  ws2812fx.setCustomMode(legacyEffect);
+  ws2812fx.setSegment(0, 0, NUM_LEDS - 1, FX_MODE_CUSTOM_0, RED, 1000, (uint8_t)NO_OPTIONS);
+  before = states[0].calls;
+  for(uint16_t t=0; t < 100; t++) {
+    ws2812fx.service();
+    clk.advance(1);
+  }
+  CHECK(legacyCalls > 0);
+  CHECK_EQUAL(states[0].calls, before);
+
+  return TEST_RESULT();
+}
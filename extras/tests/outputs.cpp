@@ -0,0 +1,104 @@
+/*
+  outputs.cpp - output table test for the WS2812FX host build.
+
+  Splits a strip across three mock FastLED controllers, one of them with a
+  refresh cap, and checks that show() only sends the outputs whose LEDs
+  changed, that the cap holds back (but doesn't lose) frames, and that
+  getTimeToNextFrame() lets a tickless loop sleep while a frame is held back.
+
+  LICENSE
+
+  The MIT License (MIT)
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include "test.h"
+
+#define NUM_LEDS 300
+#define RUN_MS   2000
+
+static CRGB leds[NUM_LEDS];
+static VirtualClock clk;
+
+int main() {
+  setHostClock(&clk);
+  clk.set(5); // less than the capped output's min_interval, its first frame still goes out
+  WS2812FX ws2812fx(leds, NUM_LEDS);
+  ws2812fx.init();
+  CHECK(ws2812fx.addLeds<WS2812, 1, GRB>(0, 99));
+  CHECK(ws2812fx.addLeds<WS2811, 2, RGB>(100, 199));
+  CHECK(ws2812fx.addLeds<WS2812, 3, GRB>(200, 299, 10)); // at most 10 fps
+  CHECK_EQUAL(ws2812fx.getNumOutputs(), 3);
+  CHECK(!ws2812fx.addLeds<WS2812, 4, GRB>(250, 300)); // past the end of the strip
+
+  ws2812fx.setNumSegments(3);
+  ws2812fx.setSegment(0, 0, 99, FX_MODE_STATIC, RED, 1000, (uint8_t)NO_OPTIONS);
+  ws2812fx.setSegment(1, 100, 199, FX_MODE_COMET, BLUE, 1000, (uint8_t)NO_OPTIONS);
+  ws2812fx.setSegment(2, 200, 299, FX_MODE_COMET, GREEN, 1000, (uint8_t)NO_OPTIONS);
+  ws2812fx.start();
+  ws2812fx.service();
+  for(uint8_t i=0; i < 3; i++) {
+    CHECK_EQUAL(FastLED[i].getShowCount(), 1); // the first frame goes out on every output
+  }
+
+  // a tickless loop: after service() there's never work to do right away
+  unsigned long wakeups = 0;
+  while(millis() < RUN_MS) {
+    unsigned long wait = ws2812fx.getTimeToNextFrame();
+    CHECK(wait > 0 && wait <= 1000);
+    if(wait == 0) wait = 1;
+    clk.advance(wait);
+    ws2812fx.service();
+    wakeups++;
+  }
+
+  CHECK_EQUAL(FastLED[0].getShowCount(), 1); // the static segment never changes
+  CHECK(FastLED[1].getShowCount() > 100);    // comet steps every 10ms
+  CHECK(FastLED[2].getShowCount() >= RUN_MS / 100 - 1 && FastLED[2].getShowCount() <= RUN_MS / 100 + 1);
+  CHECK(wakeups < FastLED[1].getShowCount() + FastLED[2].getShowCount() + 10);
+  CHECK_EQUAL(FastLED[0].getLedsSent(), 100);
+
+  // a frame held back by the cap is sent once the cap expires, even with nothing else changing
+  ws2812fx.setMode(2, FX_MODE_STATIC);
+  ws2812fx.setMode(1, FX_MODE_STATIC);
+  for(uint16_t t=0; t < 500; t++) {
+    ws2812fx.service();
+    clk.advance(1);
+  }
+  unsigned long shows = FastLED[2].getShowCount();
+  CHECK(ws2812fx.getTimeToNextFrame() > 0);
+  ws2812fx.setColor(2, BLUE);
+  ws2812fx.trigger();
+  ws2812fx.service(); // the cap has long expired, sent right away
+  CHECK_EQUAL(FastLED[2].getShowCount(), shows + 1);
+  clk.advance(10);
+  ws2812fx.setColor(2, WHITE);
+  ws2812fx.trigger();
+  ws2812fx.service(); // 10 ms after the last show, held back
+  CHECK_EQUAL(FastLED[2].getShowCount(), shows + 1);
+  unsigned long wait = ws2812fx.getTimeToNextFrame();
+  CHECK(wait >= 89 && wait <= 90);
+  clk.advance(wait);
+  ws2812fx.service();
+  CHECK_EQUAL(FastLED[2].getShowCount(), shows + 2);
+  CHECK_EQUAL((uint32_t)leds[250], WHITE);
+
+  return TEST_RESULT();
+}
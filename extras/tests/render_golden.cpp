@@ -0,0 +1,195 @@
+/*
+  render_golden.cpp - render regression test for the WS2812FX host build.
+
+  Renders every builtin mode, with several option sets and on a short and a
+  long segment, plus a mixed multi-segment setup, on a VirtualClock and
+  compares a fingerprint of the frames with the one recorded below. Changes
+  that are meant to leave the output alone (refactoring, flash tables, span
+  writes, kernel specialization...) must keep every fingerprint.
+
+  Twinkle modes use the C library's random(), the fingerprints were recorded
+  with glibc.
+
+  usage: render_golden [-p]   (-p prints the fingerprint table instead, after a
+                               deliberate change to an effect's output)
+
+  LICENSE
+
+  The MIT License (MIT)
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include "test.h"
+
+#include <string.h>
+
+#define NUM_LEDS 1000
+#define RUN_MS   3000
+#define SAMPLE_MS  50
+
+static const uint8_t optionSets[] = {NO_OPTIONS, REVERSE | GAMMA, SIZE_MEDIUM | FADE_FAST, REVERSE | SIZE_XLARGE | FADE_GLACIAL};
+static const uint16_t lengths[] = {40, NUM_LEDS};
+
+// fingerprint of every builtin mode, recorded with render_golden -p
+static const uint32_t golden[FX_MODE_CUSTOM_0] = {
+  0x019f74edUL, // 0
+  0xabdd3825UL, // 1
+  0xbcbfc8c5UL, // 2
+  0xd10b8e1dUL, // 3
+  0x28b12a3dUL, // 4
+  0x28d3b7ddUL, // 5
+  0xc9c8e47dUL, // 6
+  0x4e2fd822UL, // 7
+  0xd62e039dUL, // 8
+  0x62e80c50UL, // 9
+  0xa92b8ad1UL, // 10
+  0x4c06839dUL, // 11
+  0xbdaef285UL, // 12
+  0x19fafe79UL, // 13
+  0x383edefdUL, // 14
+  0x5b536cfdUL, // 15
+  0xe9a37e0dUL, // 16
+  0x88ba02c3UL, // 17
+  0xb92192f7UL, // 18
+  0x87fb9379UL, // 19
+  0x3c9d79b0UL, // 20
+  0x46de5f91UL, // 21
+  0x1de0bac1UL, // 22
+  0x63e69722UL, // 23
+  0xde7fd805UL, // 24
+  0x28247431UL, // 25
+  0xc289c725UL, // 26
+  0xcc5c6ed5UL, // 27
+  0xedabdf85UL, // 28
+  0x55d08295UL, // 29
+  0xd1566285UL, // 30
+  0xf64d28fdUL, // 31
+  0xd829a9d9UL, // 32
+  0xe887fd91UL, // 33
+  0xfda42f65UL, // 34
+  0x2aeed7bdUL, // 35
+  0x580b02ddUL, // 36
+  0x31dd83f5UL, // 37
+  0x4d4bb4c9UL, // 38
+  0x6535c728UL, // 39
+  0x5cd12cb1UL, // 40
+  0x58a58931UL, // 41
+  0x1277bf65UL, // 42
+  0x1b5629c4UL, // 43
+  0x906cf33eUL, // 44
+  0x231614f2UL, // 45
+  0x30d9adc8UL, // 46
+  0xfe840cd1UL, // 47
+  0xafb7821eUL, // 48
+  0x0f59f9bfUL, // 49
+  0xbdce727cUL, // 50
+  0x40bd1f4dUL, // 51
+  0xfe2f770bUL, // 52
+  0x5d9ecd45UL, // 53
+  0x71a324edUL, // 54
+  0xe880943dUL  // 55
+};
+
+// fingerprint of the mixed setup (overlapping segments, triggers), recorded with render_golden -p
+static const uint32_t goldenMixed = 0x379ea63dUL;
+
+static CRGB leds[NUM_LEDS];
+static VirtualClock clk;
+
+static uint32_t runMode(uint8_t m) {
+  uint32_t h = 2166136261UL;
+  for(uint8_t l=0; l < sizeof(lengths)/sizeof(lengths[0]); l++) {
+    for(uint8_t o=0; o < sizeof(optionSets); o++) {
+      clearLeds(leds, NUM_LEDS);
+      WS2812FX ws2812fx(leds, lengths[l]);
+      ws2812fx.init();
+      ws2812fx.setSegment(0, 0, lengths[l] - 1, m, (const uint32_t[]){RED, BLUE, GREEN}, 1000, optionSets[o]);
+      clk.set(0);
+      randomSeed(1);
+      ws2812fx.start();
+      unsigned long shows = FastLED.getShowCount();
+      for(uint16_t t=0; t < RUN_MS; t++) {
+        ws2812fx.service();
+        if(t % SAMPLE_MS == 0) h = hashLeds(leds, lengths[l], h);
+        clk.advance(1);
+      }
+      h = (h ^ (uint32_t)(FastLED.getShowCount() - shows)) * 16777619UL;
+    }
+  }
+  return h;
+}
+
+// 10 segments, two of them overlapping, every mode in use, retriggered now and then.
+// With copy the run goes on halfway with a copy of the instance, the original deleted.
+static uint32_t runMixed(boolean doubleBuffer, boolean copy) {
+  clearLeds(leds, NUM_LEDS);
+  WS2812FX* ws2812fx = new WS2812FX(leds, 300);
+  ws2812fx->init();
+  for(uint8_t s=0; s < 10; s++) {
+    ws2812fx->setSegment(s, s*30, s*30+29, (s*7+3) % FX_MODE_CUSTOM_0, (const uint32_t[]){RED, BLUE, GREEN}, 500+s*300, (uint8_t)(s & 1 ? REVERSE : GAMMA));
+  }
+  ws2812fx->setSegment(3, 80, 120, FX_MODE_FIREWORKS, RED, 700, (uint8_t)NO_OPTIONS);
+  if(doubleBuffer) CHECK(ws2812fx->setDoubleBuffer(true));
+  clk.set(0);
+  randomSeed(1);
+  ws2812fx->start();
+  uint32_t h = 2166136261UL;
+  for(uint16_t t=0; t < 20000; t++) {
+    if(copy && t == 10000) {
+      WS2812FX* original = ws2812fx;
+      ws2812fx = new WS2812FX(*original);
+      delete original;
+    }
+    ws2812fx->service();
+    if(t % 997 == 0) ws2812fx->trigger();
+    if(t % 10 == 0) h = hashLeds((const CRGB*)ws2812fx->getFrontBuffer(), 300, h);
+    for(uint8_t s=0; s < 10; s++) h = (h ^ ws2812fx->isFrame(s)) * 16777619UL;
+    clk.advance(1);
+  }
+  delete ws2812fx;
+  return h;
+}
+
+int main(int argc, char* argv[]) {
+  boolean print = argc > 1 && strcmp(argv[1], "-p") == 0;
+  setHostClock(&clk);
+
+  if(print) printf("static const uint32_t golden[FX_MODE_CUSTOM_0] = {\n");
+  for(uint8_t m=0; m < FX_MODE_CUSTOM_0; m++) {
+    uint32_t h = runMode(m);
+    if(print) {
+      printf("  0x%08lxUL%s // %u\n", (unsigned long)h, m < FX_MODE_CUSTOM_0 - 1 ? "," : " ", m);
+    } else if(h != golden[m]) {
+      printf("mode %u changed: 0x%08lx, recorded 0x%08lx\n", m, (unsigned long)h, (unsigned long)golden[m]);
+      test_failures++;
+    }
+  }
+
+  uint32_t mixed = runMixed(false, false);
+  if(print) {
+    printf("};\nstatic const uint32_t goldenMixed = 0x%08lxUL;\n", (unsigned long)mixed);
+    return 0;
+  }
+  CHECK_EQUAL(mixed, goldenMixed);
+  CHECK_EQUAL(runMixed(true, false), mixed); // the double buffer sends the same frames
+  CHECK_EQUAL(runMixed(true, true), mixed);  // and so does a copy, with a second LED array of its own
+
+  return TEST_RESULT();
+}
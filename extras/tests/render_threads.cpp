@@ -0,0 +1,140 @@
+/*
+  render_threads.cpp - thread pool test for the WS2812FX host build
+  (WS2812FX_THREADS only).
+
+  Renders the same setup with four render threads and with one and checks
+  the frames are byte for byte the same, and that segments sharing LEDs are
+  rendered one after another on the thread calling service(). Run it under
+  -DWS2812FX_SANITIZE=thread to check the pool and the per-task random seeds
+  as well, the last part renders the random modes for that.
+
+  LICENSE
+
+  The MIT License (MIT)
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include "test.h"
+
+#include <thread>
+#include <atomic>
+#include <string.h>
+
+#define NUM_LEDS     6000
+#define NUM_SEGMENTS 24
+#define RUN_MS       3000
+
+static CRGB threadedLeds[NUM_LEDS];
+static CRGB serialLeds[NUM_LEDS];
+static VirtualClock clk;
+static WS2812FXT<NUM_SEGMENTS, 3, 4> threaded(threadedLeds, NUM_LEDS);
+static WS2812FXT<NUM_SEGMENTS, 3, 4> serial(serialLeds, NUM_LEDS);
+
+// modes that don't draw random numbers, the threads' random sequences differ from the serial one
+static const uint8_t deterministicModes[] = {FX_MODE_STATIC, FX_MODE_COLOR_WIPE, FX_MODE_RAINBOW_CYCLE, FX_MODE_SCAN,
+  FX_MODE_RUNNING_LIGHTS, FX_MODE_THEATER_CHASE, FX_MODE_BREATH, FX_MODE_LARSON_SCANNER, FX_MODE_COMET,
+  FX_MODE_CHASE_RAINBOW, FX_MODE_RAINBOW, FX_MODE_FADE};
+
+static std::thread::id serviceThread;
+static std::atomic<unsigned long> offServiceThread(0);
+static std::atomic<unsigned long> customCalls(0);
+
+static uint16_t recordThread(void* /* context */) {
+  if(std::this_thread::get_id() != serviceThread) offServiceThread++;
+  customCalls++;
+  return 20;
+}
+
+template<typename FX>
+static void setup(FX& fx, uint8_t threads, boolean random) {
+  fx.init();
+  fx.setRenderThreads(threads);
+  fx.setNumSegments(NUM_SEGMENTS);
+  static const uint32_t colors[] = {RED, BLUE, GREEN};
+  uint16_t len = NUM_LEDS / NUM_SEGMENTS;
+  for(uint8_t s=0; s < NUM_SEGMENTS; s++) {
+    uint8_t mode = random ? (s * 7 + 3) % FX_MODE_CUSTOM_0 : deterministicModes[s % sizeof(deterministicModes)];
+    fx.setSegment(s, s * len, s * len + len - 1, mode, colors, 300 + s * 97, (uint8_t)(s & 1 ? REVERSE : GAMMA));
+  }
+}
+
+// non-overlapping segments: the same frames as a serial render
+static void testIdentical(void) {
+  setup(threaded, 4, false);
+  setup(serial, 1, false);
+  CHECK_EQUAL(threaded.getRenderThreads(), 4);
+  clk.set(0);
+  threaded.start();
+  serial.start();
+  unsigned long differ = 0;
+  for(uint16_t t=0; t < RUN_MS; t++) {
+    threaded.service();
+    serial.service();
+    if(memcmp(threadedLeds, serialLeds, sizeof(threadedLeds)) != 0) differ++;
+    clk.advance(1);
+  }
+  CHECK_EQUAL(differ, 0);
+  threaded.stop();
+  serial.stop();
+}
+
+// overlapping segments: rendered in index order on the service() thread
+static void testOverlap(void) {
+  threaded.init();
+  uint8_t mode = threaded.setCustomMode(F("Record"), recordThread, NULL);
+  threaded.setNumSegments(4);
+  for(uint8_t s=0; s < 4; s++) {
+    threaded.setSegment(s, s * 100, s * 100 + 150, mode, RED, 1000, (uint8_t)NO_OPTIONS); // each overlaps the next
+  }
+  serviceThread = std::this_thread::get_id();
+  clk.set(0);
+  threaded.start();
+  for(uint16_t t=0; t < 500; t++) {
+    threaded.service();
+    clk.advance(1);
+  }
+  CHECK(customCalls > 0);
+  CHECK_EQUAL(offServiceThread, 0);
+  threaded.stop();
+}
+
+// every mode, random ones included, on the pool (for the thread sanitizer)
+static void testRandomModes(void) {
+  setup(threaded, 4, true);
+  clk.set(0);
+  threaded.start();
+  unsigned long shows = FastLED.getShowCount();
+  for(uint16_t t=0; t < RUN_MS; t++) {
+    threaded.service();
+    clk.advance(1);
+  }
+  CHECK(FastLED.getShowCount() > shows);
+  threaded.stop();
+}
+
+int main() {
+  setHostClock(&clk);
+
+  testIdentical();
+  testOverlap();
+  testRandomModes();
+
+  return TEST_RESULT();
+}
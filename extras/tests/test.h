@@ -0,0 +1,71 @@
+/*
+  test.h - minimal check macros for the WS2812FX host tests.
+
+  Every test is a small program run by ctest. CHECK() reports a failed
+  condition and carries on, so one run lists every failure; the program's
+  exit status, TEST_RESULT(), fails the test if any check failed.
+
+  LICENSE
+
+  The MIT License (MIT)
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#ifndef WS2812FX_TEST_H
+#define WS2812FX_TEST_H
+
+#include <WS2812FX.h>
+#include <stdio.h>
+
+static int test_failures = 0;
+
+// variadic, so a condition can hold template arguments
+#define CHECK(...) do { \
+    if(!(__VA_ARGS__)) { \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #__VA_ARGS__); \
+      test_failures++; \
+    } \
+  } while(0)
+
+#define CHECK_EQUAL(a, b) do { \
+    unsigned long long a_ = (unsigned long long)(a), b_ = (unsigned long long)(b); \
+    if(a_ != b_) { \
+      printf("%s:%d: CHECK_EQUAL(%s, %s) failed: 0x%llx != 0x%llx\n", __FILE__, __LINE__, #a, #b, a_, b_); \
+      test_failures++; \
+    } \
+  } while(0)
+
+#define TEST_RESULT() (test_failures == 0 ? 0 : 1)
+
+static inline void clearLeds(CRGB* leds, uint16_t n) {
+  for(uint16_t i=0; i < n; i++) leds[i] = BLACK;
+}
+
+// FNV-1a over the LED array, a frame fingerprint for the golden tests
+static inline uint32_t hashLeds(const CRGB* leds, uint16_t n, uint32_t h = 2166136261UL) {
+  for(uint16_t i=0; i < n; i++) {
+    h = (h ^ leds[i].r) * 16777619UL;
+    h = (h ^ leds[i].g) * 16777619UL;
+    h = (h ^ leds[i].b) * 16777619UL;
+  }
+  return h;
+}
+
+#endif
@@ -46,6 +46,7 @@
 #define DEFAULT_BRIGHTNESS (uint8_t)50
 #define DEFAULT_MODE       (uint8_t)0
 #define DEFAULT_SPEED      (uint16_t)1000
+#define DEFAULT_FRAME_RATE (uint8_t)50 /* frames per second of a timed mode, see setFrameRate() */
 #define DEFAULT_COLOR      (uint32_t)0xFF0000
 
 #if defined(ESP8266) || defined(ESP32)
@@ -57,17 +58,72 @@
 #endif
 #define SPEED_MAX (uint16_t)65535
 
+/* some ESP32 setups glitch if show() is called right after the pixel data has been
+	updated (see https://forums.adafruit.com/viewtopic.php?f=47&t=117327). If yours does,
+	define ESP32_SHOW_DELAY as the number of milliseconds to wait before each show() */
+//#define ESP32_SHOW_DELAY 1
+
 #define BRIGHTNESS_MIN (uint8_t)0
 #define BRIGHTNESS_MAX (uint8_t)255
 
-/* each segment uses 36 bytes of SRAM memory, so if you're application fails because of
-	insufficient memory, decreasing MAX_NUM_SEGMENTS may help */
+/* capacity of the WS2812FX class. Each segment uses 47 bytes of SRAM memory, so if your
+	application fails because of insufficient memory, use the WS2812FXT template with
+	fewer segments, e.g. WS2812FXT<1, 3, 1> (see below). MAX_NUM_OUTPUTS, COMMAND_QUEUE_SIZE
+	and SCRATCH_SIZE can be defined for the whole build (e.g. PlatformIO's build_flags, so
+	the library's own source sees the same value) to shrink the tables below */
 #define MAX_NUM_SEGMENTS 10
 #define NUM_COLORS        3 /* number of colors per segment */
 #define MAX_CUSTOM_MODES  4
-#define SEGMENT          _segments[_segment_index]
-#define SEGMENT_RUNTIME  _segment_runtimes[_segment_index]
+/* LED outputs (data pins) the strip can be split into, see addLeds() */
+#if !defined(MAX_NUM_OUTPUTS)
+	#if defined(__AVR__)
+		#define MAX_NUM_OUTPUTS  2
+	#else
+		#define MAX_NUM_OUTPUTS  8
+	#endif
+#endif
+/* control changes queued for the next service() call, a power of two (see queueCommand()).
+	0 compiles the queue out, queueCommand() and friends then apply the change right away */
+#if !defined(COMMAND_QUEUE_SIZE)
+	#if defined(__AVR__)
+		#define COMMAND_QUEUE_SIZE  4
+	#else
+		#define COMMAND_QUEUE_SIZE  32
+	#endif
+#endif
+/* bytes of scratch memory the segments' custom effects can keep their state in (see getScratch()) */
+#if !defined(SCRATCH_SIZE)
+	#if defined(__AVR__)
+		#define SCRATCH_SIZE  128
+	#else
+		#define SCRATCH_SIZE  512
+	#endif
+#endif
+/* chase(), running(), tricolor_chase(), scan(), color_wipe() and running_lights() are compiled
+	once for every combination of the REVERSE, GAMMA and SIZE options, so their loops don't test the
+	options for every pixel. Define GENERIC_KERNELS to compile a single, generic version instead
+	(smaller, but slower). */
+#if defined(__AVR__) && !defined(GENERIC_KERNELS)
+	#define GENERIC_KERNELS
+#endif
+/* most steps service() renders for one segment in one frame when the segment's mode steps
+	faster than SPEED_MIN (see stepDelay()), a segment that falls further behind skips ahead */
+#if defined(__AVR__)
+	#define MAX_CATCHUP_STEPS  64
+#else
+	#define MAX_CATCHUP_STEPS  1024
+#endif
+#define RENDER_STATE     renderState()
+#define SEGMENT          _segments[RENDER_STATE.segment_index]
+#define SEGMENT_RUNTIME  _segment_runtimes[RENDER_STATE.segment_index]
 #define SEGMENT_LENGTH   (uint16_t)(SEGMENT.stop - SEGMENT.start + 1)
+#define MAX_PATTERN_LENGTH 32 /* longest fillPattern() pattern */
+/* segments at least this long are faded with lookup tables (768 bytes of stack) */
+#if defined(__AVR__)
+	#define FADE_LUT_MIN_LENGTH  UINT16_MAX
+#else
+	#define FADE_LUT_MIN_LENGTH  1024
+#endif
 
 // some common colors
 // #define RED        (uint32_t)0xFF0000
@@ -98,6 +154,13 @@
 #define ULTRAWHITE (uint32_t)0xFFFFFFFF
 #define DARK(c)    (uint32_t)((c >> 4) & 0x0f0f0f0f)
 
+// 16 color palettes, stored in flash. Palette entries are written like the other
+// colors, PALETTE_COLOR(0xFF3000) is ORANGE.
+#define PALETTE_COLOR(c) {(uint8_t)((c) >> 16), (uint8_t)((c) >> 8), (uint8_t)(c)}
+typedef struct Palette16 { // 48 bytes
+  uint8_t colors[16][3];
+} palette16;
+
 // segment options
 // bit    7: reverse animation
 // bits 4-6: fade rate (0-7)
@@ -131,7 +194,33 @@
 #define SET_CYCLE (SEGMENT_RUNTIME.aux_param2 |=  CYCLE)
 #define CLR_CYCLE (SEGMENT_RUNTIME.aux_param2 &= ~CYCLE)
 
-#define MODE_COUNT (sizeof(_names)/sizeof(_names[0]))
+#define MODE_COUNT (FX_MODE_CUSTOM_0 + _custom_modes.size())
+#define MAX_CUSTOM_MODE_COUNT (255 - FX_MODE_CUSTOM_0) // mode ids are 8 bit
+
+// mode flags (see getModeFlags())
+#define MODE_NO_FLAGS (uint8_t)B00000000
+#define MODE_REDUCED  (uint8_t)B00000001 // replaced by mode_static, see REDUCED_MODES
+#define MODE_TIMED    (uint8_t)B00000010 // driven by elapsed time and phase, see setFrameRate()
+#define MODE_CUSTOM   (uint8_t)B10000000 // a custom mode slot
+
+// queued control changes (Command.type, see queueCommand())
+#define CMD_SET_SEGMENT    (uint8_t)0 // setSegment(seg, start, stop, mode, colors, speed, options)
+#define CMD_SET_MODE       (uint8_t)1 // setMode(seg, mode)
+#define CMD_SET_COLOR      (uint8_t)2 // setColor(seg, colors[0])
+#define CMD_SET_COLORS     (uint8_t)3 // setColors(seg, colors)
+#define CMD_SET_SPEED      (uint8_t)4 // setSpeed(seg, speed)
+#define CMD_SET_OPTIONS    (uint8_t)5 // setOptions(seg, options)
+#define CMD_SET_BRIGHTNESS (uint8_t)6 // setBrightness(options), sent with the next frame
+#define CMD_START          (uint8_t)7
+#define CMD_STOP           (uint8_t)8
+#define CMD_PAUSE          (uint8_t)9
+#define CMD_RESUME         (uint8_t)10
+#define CMD_TRIGGER        (uint8_t)11
+#define CMD_SET_SCENE      (uint8_t)12 // installs the scene passed to setScene(), use setScene()
+
+// scene options (Scene_config.options, see setScene())
+#define SCENE_CLEAR           (uint8_t)B00000001 // black out the strip before the scene's first frame
+#define SCENE_KEEP_BRIGHTNESS (uint8_t)B00000010 // leave the brightness as it is
 
 #define FX_MODE_STATIC                   0
 #define FX_MODE_BLINK                    1
@@ -193,7 +282,7 @@
 #define FX_MODE_CUSTOM_0                56  // custom modes need to go at the end
 #define FX_MODE_CUSTOM_1                57
 #define FX_MODE_CUSTOM_2                58
-#define FX_MODE_CUSTOM_3                59
+#define FX_MODE_CUSTOM_3                59  // further custom modes follow, up to MaxCustomModes
 
 
 /* Similar to above, but for an 8-bit gamma-correction table.
@@ -222,232 +311,279 @@ static const uint8_t PROGMEM _NeoPixelGammaTable[256] = {
   182,184,186,188,191,193,195,197,199,202,204,206,209,211,213,215,
   218,220,223,225,227,230,232,235,237,240,242,245,247,250,252,255};
 
-// create GLOBAL names to allow WS2812FX to compile with sketches and other libs that store strings
-// in PROGMEM (get rid of the "section type conflict with __c" errors once and for all. Amen.)
-const char name_0[] PROGMEM = "Static";
-const char name_1[] PROGMEM = "Blink";
-const char name_2[] PROGMEM = "Breath";
-const char name_3[] PROGMEM = "Color Wipe";
-const char name_4[] PROGMEM = "Color Wipe Inverse";
-const char name_5[] PROGMEM = "Color Wipe Reverse";
-const char name_6[] PROGMEM = "Color Wipe Reverse Inverse";
-const char name_7[] PROGMEM = "Color Wipe Random";
-const char name_8[] PROGMEM = "Random Color";
-const char name_9[] PROGMEM = "Single Dynamic";
-const char name_10[] PROGMEM = "Multi Dynamic";
-const char name_11[] PROGMEM = "Rainbow";
-const char name_12[] PROGMEM = "Rainbow Cycle";
-const char name_13[] PROGMEM = "Scan";
-const char name_14[] PROGMEM = "Dual Scan";
-const char name_15[] PROGMEM = "Fade";
-const char name_16[] PROGMEM = "Theater Chase";
-const char name_17[] PROGMEM = "Theater Chase Rainbow";
-const char name_18[] PROGMEM = "Running Lights";
-const char name_19[] PROGMEM = "Twinkle";
-const char name_20[] PROGMEM = "Twinkle Random";
-const char name_21[] PROGMEM = "Twinkle Fade";
-const char name_22[] PROGMEM = "Twinkle Fade Random";
-const char name_23[] PROGMEM = "Sparkle";
-const char name_24[] PROGMEM = "Flash Sparkle";
-const char name_25[] PROGMEM = "Hyper Sparkle";
-const char name_26[] PROGMEM = "Strobe";
-const char name_27[] PROGMEM = "Strobe Rainbow";
-const char name_28[] PROGMEM = "Multi Strobe";
-const char name_29[] PROGMEM = "Blink Rainbow";
-const char name_30[] PROGMEM = "Chase White";
-const char name_31[] PROGMEM = "Chase Color";
-const char name_32[] PROGMEM = "Chase Random";
-const char name_33[] PROGMEM = "Chase Rainbow";
-const char name_34[] PROGMEM = "Chase Flash";
-const char name_35[] PROGMEM = "Chase Flash Random";
-const char name_36[] PROGMEM = "Chase Rainbow White";
-const char name_37[] PROGMEM = "Chase Blackout";
-const char name_38[] PROGMEM = "Chase Blackout Rainbow";
-const char name_39[] PROGMEM = "Color Sweep Random";
-const char name_40[] PROGMEM = "Running Color";
-const char name_41[] PROGMEM = "Running Red Blue";
-const char name_42[] PROGMEM = "Running Random";
-const char name_43[] PROGMEM = "Larson Scanner";
-const char name_44[] PROGMEM = "Comet";
-const char name_45[] PROGMEM = "Fireworks";
-const char name_46[] PROGMEM = "Fireworks Random";
-const char name_47[] PROGMEM = "Merry Christmas";
-const char name_48[] PROGMEM = "Fire Flicker";
-const char name_49[] PROGMEM = "Fire Flicker (soft)";
-const char name_50[] PROGMEM = "Fire Flicker (intense)";
-const char name_51[] PROGMEM = "Circus Combustus";
-const char name_52[] PROGMEM = "Halloween";
-const char name_53[] PROGMEM = "Bicolor Chase";
-const char name_54[] PROGMEM = "Tricolor Chase";
-const char name_55[] PROGMEM = "ICU";
-const char name_56[] PROGMEM = "Custom 0"; // custom modes need to go at the end
-const char name_57[] PROGMEM = "Custom 1";
-const char name_58[] PROGMEM = "Custom 2";
-const char name_59[] PROGMEM = "Custom 3";
-
-static const __FlashStringHelper* _names[] = {
-	FSH(name_0),
-	FSH(name_1),
-	FSH(name_2),
-	FSH(name_3),
-	FSH(name_4),
-	FSH(name_5),
-	FSH(name_6),
-	FSH(name_7),
-	FSH(name_8),
-	FSH(name_9),
-	FSH(name_10),
-	FSH(name_11),
-	FSH(name_12),
-	FSH(name_13),
-	FSH(name_14),
-	FSH(name_15),
-	FSH(name_16),
-	FSH(name_17),
-	FSH(name_18),
-	FSH(name_19),
-	FSH(name_20),
-	FSH(name_21),
-	FSH(name_22),
-	FSH(name_23),
-	FSH(name_24),
-	FSH(name_25),
-	FSH(name_26),
-	FSH(name_27),
-	FSH(name_28),
-	FSH(name_29),
-	FSH(name_30),
-	FSH(name_31),
-	FSH(name_32),
-	FSH(name_33),
-	FSH(name_34),
-	FSH(name_35),
-	FSH(name_36),
-	FSH(name_37),
-	FSH(name_38),
-	FSH(name_39),
-	FSH(name_40),
-	FSH(name_41),
-	FSH(name_42),
-	FSH(name_43),
-	FSH(name_44),
-	FSH(name_45),
-	FSH(name_46),
-	FSH(name_47),
-	FSH(name_48),
-	FSH(name_49),
-	FSH(name_50),
-	FSH(name_51),
-	FSH(name_52),
-	FSH(name_53),
-	FSH(name_54),
-	FSH(name_55),
-	FSH(name_56),
-	FSH(name_57),
-	FSH(name_58),
-	FSH(name_59)
+// color wheel, defined once in WS2812FX.cpp (see color_wheel())
+extern const uint8_t _ColorWheelTable[256][3] PROGMEM;
+
+// builtin palettes, defined once in WS2812FX.cpp (see setPalette())
+extern const palette16 palette_party PROGMEM;
+extern const palette16 palette_ocean PROGMEM;
+extern const palette16 palette_forest PROGMEM;
+extern const palette16 palette_lava PROGMEM;
+extern const palette16 palette_cloud PROGMEM;
+extern const palette16 palette_heat PROGMEM;
+
+// GLOBAL mode names, defined once in WS2812FX.cpp (storing them in PROGMEM as globals gets rid of
+// the "section type conflict with __c" errors with sketches and other libs that store strings in PROGMEM)
+extern const char name_0[] PROGMEM;
+extern const char name_1[] PROGMEM;
+extern const char name_2[] PROGMEM;
+extern const char name_3[] PROGMEM;
+extern const char name_4[] PROGMEM;
+extern const char name_5[] PROGMEM;
+extern const char name_6[] PROGMEM;
+extern const char name_7[] PROGMEM;
+extern const char name_8[] PROGMEM;
+extern const char name_9[] PROGMEM;
+extern const char name_10[] PROGMEM;
+extern const char name_11[] PROGMEM;
+extern const char name_12[] PROGMEM;
+extern const char name_13[] PROGMEM;
+extern const char name_14[] PROGMEM;
+extern const char name_15[] PROGMEM;
+extern const char name_16[] PROGMEM;
+extern const char name_17[] PROGMEM;
+extern const char name_18[] PROGMEM;
+extern const char name_19[] PROGMEM;
+extern const char name_20[] PROGMEM;
+extern const char name_21[] PROGMEM;
+extern const char name_22[] PROGMEM;
+extern const char name_23[] PROGMEM;
+extern const char name_24[] PROGMEM;
+extern const char name_25[] PROGMEM;
+extern const char name_26[] PROGMEM;
+extern const char name_27[] PROGMEM;
+extern const char name_28[] PROGMEM;
+extern const char name_29[] PROGMEM;
+extern const char name_30[] PROGMEM;
+extern const char name_31[] PROGMEM;
+extern const char name_32[] PROGMEM;
+extern const char name_33[] PROGMEM;
+extern const char name_34[] PROGMEM;
+extern const char name_35[] PROGMEM;
+extern const char name_36[] PROGMEM;
+extern const char name_37[] PROGMEM;
+extern const char name_38[] PROGMEM;
+extern const char name_39[] PROGMEM;
+extern const char name_40[] PROGMEM;
+extern const char name_41[] PROGMEM;
+extern const char name_42[] PROGMEM;
+extern const char name_43[] PROGMEM;
+extern const char name_44[] PROGMEM;
+extern const char name_45[] PROGMEM;
+extern const char name_46[] PROGMEM;
+extern const char name_47[] PROGMEM;
+extern const char name_48[] PROGMEM;
+extern const char name_49[] PROGMEM;
+extern const char name_50[] PROGMEM;
+extern const char name_51[] PROGMEM;
+extern const char name_52[] PROGMEM;
+extern const char name_53[] PROGMEM;
+extern const char name_54[] PROGMEM;
+extern const char name_55[] PROGMEM;
+extern const char name_56[] PROGMEM;
+extern const char name_57[] PROGMEM;
+extern const char name_58[] PROGMEM;
+extern const char name_59[] PROGMEM;
+
+#if !defined(__AVR__)
+#include <atomic>
+#endif
+
+#ifdef WS2812FX_THREADS
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+
+/*
+ * Work-stealing thread pool for rendering segments in parallel (host builds,
+ * see setRenderThreads()). run() deals the tasks out round robin to one queue
+ * per thread. Every thread, the caller included, takes tasks from the front of
+ * its own queue and then steals from the back of the others, so a few costly
+ * segments don't leave the other threads idle. All instances share one pool.
+ */
+class WS2812FX_pool {
+	public:
+		typedef void (*task_fn)(void* arg, uint8_t task);
+
+		static WS2812FX_pool& instance(void);
+
+		void setThreads(uint8_t n); // worker threads besides the caller of run()
+		uint8_t getThreads(void);
+		void run(task_fn fn, void* arg, uint8_t n); // calls fn(arg, 0..n-1), returns when all are done
+		std::mutex& mutex(void) { return _data_mutex; } // guards the engine state tasks share
+
+	private:
+		WS2812FX_pool(void);
+		~WS2812FX_pool(void);
+		WS2812FX_pool(const WS2812FX_pool&) = delete;
+		WS2812FX_pool& operator=(const WS2812FX_pool&) = delete;
+
+		struct Queue {
+			std::mutex lock;
+			uint8_t tasks[256];
+			uint16_t head = 0;
+			uint16_t tail = 0;
+		};
+
+		boolean take(uint8_t q, uint8_t& task);
+		void work(uint8_t q);
+		void loop(uint8_t q, uint32_t generation);
+		void stop(void);
+
+		Queue* _queues;
+		uint8_t _num_queues;
+		std::vector<std::thread> _threads;
+		std::mutex _run_mutex;  // one run() at a time
+		std::mutex _mutex;      // guards _generation and _quit
+		std::mutex _data_mutex;
+		std::condition_variable _wake, _done;
+		uint32_t _generation = 0;
+		boolean _quit = false;
+		task_fn _fn = NULL;
+		void* _arg = NULL;
+		std::atomic<int> _remaining;
 };
+#endif
 
-class WS2812FX {
+/*
+ * The LED arrays of an engine. They live in a base class so that copying an
+ * engine can give the copy a second LED array of its own: a copy made while
+ * setDoubleBuffer() is on gets its own spare array with the pixels copied, or
+ * runs without the double buffer if that can't be allocated.
+ */
+class WS2812FX_buffers {
+	protected:
+		WS2812FX_buffers(void) : ledArray(NULL), _frame(NULL), _front(NULL), numLEDs(0), numBytes(0), _spare(NULL) {}
+		WS2812FX_buffers(const WS2812FX_buffers& other) : _spare(NULL) {
+			*this = other;
+		}
+		~WS2812FX_buffers(void) {
+			free(_spare);
+		}
+		WS2812FX_buffers& operator=(const WS2812FX_buffers& other);
+
+		// TODO : Make sure this gets set
+		struct CRGB* ledArray; // LED array the next frame is written to
+		struct CRGB* _frame;   // render buffer, ledArray unless setLinearBuffer() is used
+		struct CRGB* _front;   // LED array sent by FastLED.show()/customShow(), ledArray unless setDoubleBuffer() is used
+		uint16_t numLEDs; //Number of LEDs
+		uint16_t numBytes;	//Size of pixels buffer
+		struct CRGB* _spare;   // second LED array (numBytes) on the heap, NULL unless setDoubleBuffer() is on
+};
 
-	typedef uint16_t (WS2812FX::*mode_ptr)(void);
+/*
+ * The effects engine. The number of segments, colors per segment and custom
+ * modes are template parameters, so every instance holds exactly the arrays
+ * it needs:
+ *
+ *   WS2812FXT<1, 3, 1> ws2812fx(leds, LED_COUNT);   // small board, one segment
+ *   WS2812FXT<64, 3, 8> ws2812fx(leds, LED_COUNT);  // large fixture
+ *
+ * An optional fourth parameter sets the size of the custom effect scratch
+ * memory (SCRATCH_SIZE by default).
+ *
+ * The builtin modes use the first three colors of a segment, so NumColors
+ * has to be at least 3. Each distinct set of parameters compiles its own copy
+ * of the engine code, WS2812FX is the default configuration.
+ */
+template<uint8_t MaxSegments, uint8_t NumColors, uint8_t MaxCustomModes, uint16_t ScratchSize = SCRATCH_SIZE>
+class WS2812FXT : private WS2812FX_buffers {
+
+	static_assert(MaxSegments > 0, "WS2812FXT needs at least one segment");
+	static_assert(NumColors >= 3, "the builtin modes use three colors per segment");
+	static_assert(MaxCustomModes > 0 && MaxCustomModes <= MAX_CUSTOM_MODE_COUNT, "mode ids are 8 bit");
+	static_assert((COMMAND_QUEUE_SIZE & (COMMAND_QUEUE_SIZE - 1)) == 0 && COMMAND_QUEUE_SIZE <= 1024,
+		"COMMAND_QUEUE_SIZE must be a power of two (or 0)");
+	static_assert(MAX_NUM_OUTPUTS > 0, "MAX_NUM_OUTPUTS must be at least 1");
+
+	typedef uint16_t (WS2812FXT::*mode_ptr)(void);
+	typedef void (WS2812FXT::*timed_mode_ptr)(uint16_t elapsed, uint16_t phase);
+
+	// builtin mode table entry, the table itself lives in flash (PROGMEM)
+	typedef struct Mode_descriptor {
+		const char* name; // PROGMEM string
+		mode_ptr    fn;
+		uint8_t     flags;
+	} mode_descriptor;
+
+	static const mode_descriptor _modes[FX_MODE_CUSTOM_0];
 	
 	// segment parameters
 	public:
-		typedef struct Segment { // 20 bytes
+		typedef struct Segment { // 9 bytes + 4 bytes per color + a pointer
 			uint16_t start;
 			uint16_t stop;
 			uint16_t speed;
 			uint8_t  mode;
 			uint8_t  options;
-			uint32_t colors[NUM_COLORS];
+			uint32_t colors[NumColors];
+			const palette16* palette; // flash palette, NULL: the color wheel
+			uint8_t  frame_rate;      // frames per second of a timed mode, 0: DEFAULT_FRAME_RATE
 		} segment;
 
 	// segment runtime parameters
-		typedef struct Segment_runtime { // 16 bytes
+		typedef struct Segment_runtime { // 18 bytes
 			unsigned long next_time;
 			uint32_t counter_mode_step;
 			uint32_t counter_mode_call;
 			uint8_t aux_param;   // auxilary param (usually stores a color_wheel index)
 			uint8_t aux_param2;  // auxilary param (usually stores bitwise options)
 			uint16_t aux_param3; // auxilary param (usually stores a segment index)
+			uint16_t step_frac;  // fraction (1/65536 ms) of next_time, see stepDelay()
 		} segment_runtime;
 
+	// timed custom effect, gets the ms since its last frame and the segment's phase (0-65535 per speed cycle)
+		typedef void (*timed_custom_fn)(void* context, uint16_t elapsed, uint16_t phase);
 
-		WS2812FX(struct CRGB* leds, uint16_t numLeds) {
-
-			_mode[FX_MODE_STATIC]                  = &WS2812FX::mode_static;
-			_mode[FX_MODE_BLINK]                   = &WS2812FX::mode_blink;
-			_mode[FX_MODE_COLOR_WIPE]              = &WS2812FX::mode_color_wipe;
-			_mode[FX_MODE_COLOR_WIPE_INV]          = &WS2812FX::mode_color_wipe_inv;
-			_mode[FX_MODE_COLOR_WIPE_REV]          = &WS2812FX::mode_color_wipe_rev;
-			_mode[FX_MODE_COLOR_WIPE_REV_INV]      = &WS2812FX::mode_color_wipe_rev_inv;
-			_mode[FX_MODE_COLOR_WIPE_RANDOM]       = &WS2812FX::mode_color_wipe_random;
-			_mode[FX_MODE_RANDOM_COLOR]            = &WS2812FX::mode_random_color;
-			_mode[FX_MODE_SINGLE_DYNAMIC]          = &WS2812FX::mode_single_dynamic;
-			_mode[FX_MODE_MULTI_DYNAMIC]           = &WS2812FX::mode_multi_dynamic;
-			_mode[FX_MODE_RAINBOW]                 = &WS2812FX::mode_rainbow;
-			_mode[FX_MODE_RAINBOW_CYCLE]           = &WS2812FX::mode_rainbow_cycle;
-			_mode[FX_MODE_SCAN]                    = &WS2812FX::mode_scan;
-			_mode[FX_MODE_DUAL_SCAN]               = &WS2812FX::mode_dual_scan;
-			_mode[FX_MODE_FADE]                    = &WS2812FX::mode_fade;
-			_mode[FX_MODE_THEATER_CHASE]           = &WS2812FX::mode_theater_chase;
-			_mode[FX_MODE_THEATER_CHASE_RAINBOW]   = &WS2812FX::mode_theater_chase_rainbow;
-			_mode[FX_MODE_TWINKLE]                 = &WS2812FX::mode_twinkle;
-			_mode[FX_MODE_TWINKLE_RANDOM]          = &WS2812FX::mode_twinkle_random;
-			_mode[FX_MODE_TWINKLE_FADE]            = &WS2812FX::mode_twinkle_fade;
-			_mode[FX_MODE_TWINKLE_FADE_RANDOM]     = &WS2812FX::mode_twinkle_fade_random;
-			_mode[FX_MODE_SPARKLE]                 = &WS2812FX::mode_sparkle;
-			_mode[FX_MODE_FLASH_SPARKLE]           = &WS2812FX::mode_flash_sparkle;
-			_mode[FX_MODE_HYPER_SPARKLE]           = &WS2812FX::mode_hyper_sparkle;
-			_mode[FX_MODE_STROBE]                  = &WS2812FX::mode_strobe;
-			_mode[FX_MODE_STROBE_RAINBOW]          = &WS2812FX::mode_strobe_rainbow;
-			_mode[FX_MODE_MULTI_STROBE]            = &WS2812FX::mode_multi_strobe;
-			_mode[FX_MODE_BLINK_RAINBOW]           = &WS2812FX::mode_blink_rainbow;
-			_mode[FX_MODE_CHASE_WHITE]             = &WS2812FX::mode_chase_white;
-			_mode[FX_MODE_CHASE_COLOR]             = &WS2812FX::mode_chase_color;
-			_mode[FX_MODE_CHASE_RANDOM]            = &WS2812FX::mode_chase_random;
-			_mode[FX_MODE_CHASE_RAINBOW]           = &WS2812FX::mode_chase_rainbow;
-			_mode[FX_MODE_CHASE_FLASH]             = &WS2812FX::mode_chase_flash;
-			_mode[FX_MODE_CHASE_FLASH_RANDOM]      = &WS2812FX::mode_chase_flash_random;
-			_mode[FX_MODE_CHASE_RAINBOW_WHITE]     = &WS2812FX::mode_chase_rainbow_white;
-			_mode[FX_MODE_CHASE_BLACKOUT]          = &WS2812FX::mode_chase_blackout;
-			_mode[FX_MODE_CHASE_BLACKOUT_RAINBOW]  = &WS2812FX::mode_chase_blackout_rainbow;
-			_mode[FX_MODE_COLOR_SWEEP_RANDOM]      = &WS2812FX::mode_color_sweep_random;
-			_mode[FX_MODE_RUNNING_COLOR]           = &WS2812FX::mode_running_color;
-			_mode[FX_MODE_RUNNING_RED_BLUE]        = &WS2812FX::mode_running_red_blue;
-			_mode[FX_MODE_RUNNING_RANDOM]          = &WS2812FX::mode_running_random;
-			_mode[FX_MODE_LARSON_SCANNER]          = &WS2812FX::mode_larson_scanner;
-			_mode[FX_MODE_COMET]                   = &WS2812FX::mode_comet;
-			_mode[FX_MODE_FIREWORKS]               = &WS2812FX::mode_fireworks;
-			_mode[FX_MODE_FIREWORKS_RANDOM]        = &WS2812FX::mode_fireworks_random;
-			_mode[FX_MODE_MERRY_CHRISTMAS]         = &WS2812FX::mode_merry_christmas;
-			_mode[FX_MODE_FIRE_FLICKER]            = &WS2812FX::mode_fire_flicker;
-			_mode[FX_MODE_FIRE_FLICKER_SOFT]       = &WS2812FX::mode_fire_flicker_soft;
-			_mode[FX_MODE_FIRE_FLICKER_INTENSE]    = &WS2812FX::mode_fire_flicker_intense;
-			_mode[FX_MODE_CIRCUS_COMBUSTUS]        = &WS2812FX::mode_circus_combustus;
-			_mode[FX_MODE_HALLOWEEN]               = &WS2812FX::mode_halloween;
-			_mode[FX_MODE_BICOLOR_CHASE]           = &WS2812FX::mode_bicolor_chase;
-			_mode[FX_MODE_TRICOLOR_CHASE]          = &WS2812FX::mode_tricolor_chase;
-// if flash memory is constrained (I'm looking at you Arduino Nano), replace modes
-// that use a lot of flash with mode_static (reduces flash footprint by about 2100 bytes)
-#ifdef REDUCED_MODES
-			_mode[FX_MODE_BREATH]                  = &WS2812FX::mode_static;
-			_mode[FX_MODE_RUNNING_LIGHTS]          = &WS2812FX::mode_static;
-			_mode[FX_MODE_ICU]                     = &WS2812FX::mode_static;
-#else
-			_mode[FX_MODE_BREATH]                  = &WS2812FX::mode_breath;
-			_mode[FX_MODE_RUNNING_LIGHTS]          = &WS2812FX::mode_running_lights;
-			_mode[FX_MODE_ICU]                     = &WS2812FX::mode_icu;
-#endif
-			_mode[FX_MODE_CUSTOM_0]                = &WS2812FX::mode_custom_0;
-			_mode[FX_MODE_CUSTOM_1]                = &WS2812FX::mode_custom_1;
-			_mode[FX_MODE_CUSTOM_2]                = &WS2812FX::mode_custom_2;
-			_mode[FX_MODE_CUSTOM_3]                = &WS2812FX::mode_custom_3;
+	// custom mode registry entry
+		typedef struct Custom_mode {
+			uint16_t (*fn)(void* context); // NULL (and no timed_fn): empty slot
+			timed_custom_fn timed_fn;      // MODE_TIMED effect, used instead of fn
+			void* context;
+			const __FlashStringHelper* name; // NULL: use the default name
+			uint8_t flags; // MODE_TIMED
+		} custom_mode;
+
+	// LED output, a range of LEDs sent by its own FastLED controller (see addLeds())
+		typedef struct Output { // 13 bytes (AVR)
+			uint16_t start;
+			uint16_t stop;
+			CLEDController* controller;
+			uint16_t min_interval;   // refresh cap, minimum ms between two shows (0: none)
+			unsigned long last_show;
+			boolean pending;         // has changes held back by the refresh cap
+		} output;
+
+	// complete segment setup, prepared off to the side and installed between two frames by setScene()
+		typedef struct Scene_config { // 3 bytes + MaxSegments segments
+			uint8_t num_segments;
+			uint8_t brightness;
+			uint8_t options;     // SCENE_CLEAR, SCENE_KEEP_BRIGHTNESS
+			segment segments[MaxSegments];
+		} scene_config;
+
+	// control change for queueCommand(), the fields a command type doesn't use are ignored
+		typedef struct Command { // 10 bytes + 4 bytes per color
+			uint8_t  type;       // CMD_SET_MODE, ...
+			uint8_t  seg;
+			uint16_t start;
+			uint16_t stop;
+			uint16_t speed;
+			uint8_t  mode;
+			uint8_t  options;    // options, or the brightness of CMD_SET_BRIGHTNESS
+			uint32_t colors[NumColors];
+		} command;
 
+
+		WS2812FXT(struct CRGB* leds, uint16_t numLeds) {
 			numLEDs = numLeds;
 			ledArray = leds;
+			_frame = leds;
+			_front = leds;
 			numBytes = sizeof(ledArray[0]) * numLeds;
+			setDirty();
+			_brightness = DEFAULT_BRIGHTNESS;
 			FastLED.setBrightness(DEFAULT_BRIGHTNESS);
 			_running = false;
 			_num_segments = 1;
@@ -459,13 +595,16 @@ class WS2812FX {
 			resetSegmentRuntimes();
 		}
 
-		WS2812FX(void) {
+		WS2812FXT(void) {
 			numLEDs = 0;
 			ledArray = NULL;
+			_frame = NULL;
+			_front = NULL;
 			numBytes = 0;
+			_brightness = DEFAULT_BRIGHTNESS;
 		}
 
-		~WS2812FX() {
+		~WS2812FXT() {
 
 		}
 
@@ -485,8 +624,11 @@ class WS2812FX {
 			setOptions(uint8_t seg, uint8_t o),
 			setCustomMode(uint16_t (*p)()),
 			setCustomShow(void (*p)()),
+			setCustomShow(void (*p)(), boolean (*busy)()),
 			setSpeed(uint16_t s),
 			setSpeed(uint8_t seg, uint16_t s),
+			setFrameRate(uint8_t seg, uint8_t fps),
+			setMaxRefreshRate(uint8_t output, uint8_t fps),
 			increaseSpeed(uint8_t s),
 			decreaseSpeed(uint8_t s),
 			setColor(uint8_t r, uint8_t g, uint8_t b),
@@ -514,11 +656,45 @@ class WS2812FX {
 			setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b),
 			setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b, uint8_t w),
 			copyPixels(uint16_t d, uint16_t s, uint16_t c),
+			fill(uint8_t seg, uint32_t c),
+			fillPattern(uint8_t seg, const uint32_t* pattern, uint8_t len),
+			writeSpan(uint8_t seg, uint16_t offset, const uint32_t* colors, uint16_t count),
+			blendSpan(uint32_t* dest, const uint32_t* a, const uint32_t* b, uint8_t amount, uint16_t n),
+			blendSpans(uint32_t* dest, const uint32_t* a, const uint32_t* b, const uint8_t* amounts, uint16_t n),
+			hueRamp(uint8_t seg, uint8_t startHue, uint16_t hueStep16),
+			setPalette(uint8_t seg, const palette16* p),
+			setDirty(void),
+			setDirty(uint16_t first, uint16_t last),
+			setSuppressDuplicates(boolean enable),
+			setColorOrder(EOrder order),
+#ifdef WS2812FX_THREADS
+			setRenderThreads(uint8_t n),
+#endif
 			show(void);
 
+			/*
+			 * Adds an output: LEDs start to stop are sent through their own FastLED
+			 * controller, with its own chipset and color order, at most maxFps times
+			 * per second (0: no cap). Once outputs are added, show() only sends the
+			 * outputs whose LEDs changed. Returns false if MAX_NUM_OUTPUTS are in use.
+			 */
+			template<template<uint8_t DATA_PIN, EOrder RGB_ORDER> class CHIPSET, uint8_t PIN, EOrder ORDER>
+			boolean addLeds(uint16_t start, uint16_t stop, uint8_t maxFps = 0) {
+			    if(_num_outputs >= MAX_NUM_OUTPUTS || start > stop || stop >= numLEDs) return false;
+			    CLEDController& c = FastLED.addLeds<CHIPSET, PIN, ORDER>(ledArray, start, stop - start + 1);
+			    output& o = _outputs[_num_outputs++];
+			    o.start = start;
+			    o.stop = stop;
+			    o.controller = &c;
+			    o.last_show = millis() - UINT16_MAX; // the first show is never held back
+			    o.pending = false;
+			    setMaxRefreshRate(_num_outputs - 1, maxFps);
+			    return true;
+			}
+
 			template<uint8_t PIN>
-			void addLeds(uint16_t start, uint16_t stop) {
-			    FastLED.addLeds<WS2812, PIN>(ledArray, start, stop);
+			boolean addLeds(uint16_t start, uint16_t stop) {
+			    return addLeds<WS2812, PIN, RGB>(start, stop);
 			}
 
 
@@ -526,10 +702,23 @@ class WS2812FX {
 		boolean
 			isRunning(void),
 			isTriggered(void),
+			isShowing(void),
+			isDirty(void),
 			isFrame(void),
 			isFrame(uint8_t),
 			isCycle(void),
-			isCycle(uint8_t);
+			isCycle(uint8_t),
+			setLinearBuffer(struct CRGB* frame),
+			setDoubleBuffer(boolean enable),
+			queueCommand(const command& c),
+			queueSegment(uint8_t seg, uint16_t start, uint16_t stop, uint8_t mode, const uint32_t colors[], uint16_t speed, uint8_t options),
+			queueMode(uint8_t seg, uint8_t mode),
+			queueColor(uint8_t seg, uint32_t color),
+			queueSpeed(uint8_t seg, uint16_t speed),
+			queueBrightness(uint8_t brightness),
+			setScene(const scene_config* s),
+			isScenePending(void),
+			isValidScene(const scene_config* s);
 
 		uint8_t
 			random8(void),
@@ -538,28 +727,54 @@ class WS2812FX {
 			getMode(uint8_t),
 			getBrightness(void),
 			getModeCount(void),
+			getModeFlags(uint8_t m),
 			setCustomMode(const __FlashStringHelper* name, uint16_t (*p)()),
 			setCustomMode(uint8_t i, const __FlashStringHelper* name, uint16_t (*p)()),
+			setCustomMode(const __FlashStringHelper* name, uint16_t (*p)(void*), void* context),
+			setCustomMode(uint8_t i, const __FlashStringHelper* name, uint16_t (*p)(void*), void* context),
+			setCustomMode(const __FlashStringHelper* name, void (*p)(uint16_t elapsed, uint16_t phase)),
+			setCustomMode(const __FlashStringHelper* name, timed_custom_fn p, void* context),
+			getFrameRate(uint8_t seg),
 			getNumSegments(void),
+			getNumOutputs(void),
+#ifdef WS2812FX_THREADS
+			getRenderThreads(void),
+#endif
+			getSegmentIndex(void),
 			get_random_wheel_index(uint8_t),
 			getOptions(uint8_t),
 			getNumBytesPerPixel(void);
 
-		uint8_t* getPixels(void);
+		uint8_t
+			*getPixels(void),
+			*getFrontBuffer(void);
+
+		void getScene(scene_config* s);
+
+		void* getScratch(uint16_t size);
 
 		uint16_t
 			random16(void),
 			random16(uint16_t),
 			getSpeed(void),
 			getSpeed(uint8_t),
+			getFrameInterval(uint8_t seg),
 			getLength(void),
-			getNumBytes(void);
+			getNumBytes(void),
+			getDirtyStart(void),
+			getDirtyStop(void);
+
+		unsigned long
+			getTimeToNextFrame(void);
 
 		uint32_t
 			color_wheel(uint8_t),
+			palette_color(uint8_t),
+			palette_color(const palette16* p, uint8_t),
 			getColor(void),
 			getPixelColor(uint16_t n),
 			getColor(uint8_t),
+			getSuppressedFrames(void),
 			intensitySum(void);
 
 
@@ -570,24 +785,32 @@ class WS2812FX {
 		uint32_t* getColors(uint8_t);
 		uint32_t* intensitySums(void);
 
+#ifdef WS2812FX_STATS
+		// number of setPixelColor() calls since the last reset (for benchmarking)
+		uint32_t getPixelWriteCount(void) { return _render.pixel_writes; }
+		void resetPixelWriteCount(void) { _render.pixel_writes = 0; }
+#endif
+
 		const __FlashStringHelper* getModeName(uint8_t m);
 
-		WS2812FX::Segment* getSegment(void);
+		Segment* getSegment(void);
 
-		WS2812FX::Segment* getSegment(uint8_t);
+		Segment* getSegment(uint8_t);
 
-		WS2812FX::Segment* getSegments(void);
+		Segment* getSegments(void);
 
-		WS2812FX::Segment_runtime* getSegmentRuntime(void);
+		Segment_runtime* getSegmentRuntime(void);
 
-		WS2812FX::Segment_runtime* getSegmentRuntime(uint8_t);
+		Segment_runtime* getSegmentRuntime(uint8_t);
 
-		WS2812FX::Segment_runtime* getSegmentRuntimes(void);
+		Segment_runtime* getSegmentRuntimes(void);
+
+		Output* getOutput(uint8_t);
 
 		// mode helper functions
 		uint16_t
 			blink(uint32_t, uint32_t, bool strobe),
-			color_wipe(uint32_t, uint32_t, bool),
+			color_wipe(uint32_t, uint32_t, bool, uint32_t),
 			twinkle(uint32_t, uint32_t),
 			twinkle_fade(uint32_t),
 			chase(uint32_t, uint32_t, uint32_t),
@@ -595,7 +818,9 @@ class WS2812FX {
 			fireworks(uint32_t),
 			fire_flicker(int),
 			tricolor_chase(uint32_t, uint32_t, uint32_t),
-			scan(uint32_t, uint32_t, bool);
+			scan(uint32_t, uint32_t, bool),
+			running_lights(uint32_t),
+			stepDelay(uint32_t steps);
 		uint32_t
 			color_blend(uint32_t, uint32_t, uint8_t);
 
@@ -616,13 +841,10 @@ class WS2812FX {
 			mode_single_dynamic(void),
 			mode_multi_dynamic(void),
 			mode_breath(void),
-			mode_fade(void),
 			mode_scan(void),
 			mode_dual_scan(void),
 			mode_theater_chase(void),
 			mode_theater_chase_rainbow(void),
-			mode_rainbow(void),
-			mode_rainbow_cycle(void),
 			mode_running_lights(void),
 			mode_twinkle(void),
 			mode_twinkle_random(void),
@@ -657,38 +879,293 @@ class WS2812FX {
 			mode_bicolor_chase(void),
 			mode_tricolor_chase(void),
 			mode_icu(void),
-			mode_custom_0(void),
-			mode_custom_1(void),
-			mode_custom_2(void),
-			mode_custom_3(void);
+			mode_custom(void);
+
+		// builtin timed modes (MODE_TIMED)
+		void
+			mode_fade(uint16_t elapsed, uint16_t phase),
+			mode_rainbow(uint16_t elapsed, uint16_t phase),
+			mode_rainbow_cycle(uint16_t elapsed, uint16_t phase);
+		template<timed_mode_ptr F> uint16_t timed(void); // mode table adapter
 
 	private:
-		// TODO : Make sure this gets set
-		struct CRGB* ledArray;
-		uint16_t numLEDs; //Number of LEDs
-		uint16_t numBytes;	//Size of pixels buffer
-		uint16_t _rand16seed;
-		uint16_t (*customModes[MAX_CUSTOM_MODES])(void) {
-			[]{ return (uint16_t)1000; },
-			[]{ return (uint16_t)1000; },
-			[]{ return (uint16_t)1000; },
-			[]{ return (uint16_t)1000; }
+		/*
+		 * State of the segment being rendered. service() renders with _render, with
+		 * WS2812FX_THREADS every pool task renders with a state of its own, so tasks
+		 * running at the same time don't share a segment index or dirty span.
+		 */
+		typedef struct Render_state {
+			uint8_t segment_index = 0;
+			uint32_t step_time = 0; // step time (1/65536 ms) of a fast stepping mode, set by stepDelay()
+			boolean catch_up = false; // the step being rendered is not the last one of the frame
+			// span of pixels changed since the last show(), empty when dirty_start > dirty_stop
+			uint16_t dirty_start = UINT16_MAX;
+			uint16_t dirty_stop = 0;
+			uint16_t rand16seed = 0;
+#ifdef WS2812FX_STATS
+			uint32_t pixel_writes = 0;
+#endif
+#ifdef WS2812FX_THREADS
+			WS2812FXT* owner = NULL;
+#endif
+		} render_state;
+
+		render_state _render;
+#ifdef WS2812FX_THREADS
+		static thread_local render_state* _task_state; // state of the pool task running on this thread
+		uint8_t _render_threads = 1;
+		boolean _scratch_gaps = false; // a pool task moved its scratch block, see getScratch()
+
+		render_state& renderState(void) {
+			render_state* s = _task_state;
+			return (s != NULL && s->owner == this) ? *s : _render;
+		}
+#else
+		render_state& renderState(void) { return _render; }
+#endif
+		/*
+		 * Custom mode registry. The first MaxCustomModes entries are stored in the
+		 * instance itself. Registering more moves the table to the heap, doubling its
+		 * capacity each time, so a long list of effects costs a handful of reallocs.
+		 */
+		class Custom_modes {
+			public:
+				Custom_modes(void) : _entries(_slots), _size(MaxCustomModes), _capacity(MaxCustomModes) {
+					memset(_slots, 0, sizeof(_slots));
+				}
+				Custom_modes(const Custom_modes& other) : _entries(_slots), _size(0), _capacity(MaxCustomModes) {
+					*this = other;
+				}
+				~Custom_modes(void) {
+					if(_entries != _slots) free(_entries);
+				}
+				Custom_modes& operator=(const Custom_modes& other);
+
+				uint8_t size(void) { return _size; }
+				custom_mode& operator[](uint8_t i) { return _entries[i]; }
+				boolean resize(uint8_t n); // grow to n entries, new entries are empty
+
+			private:
+				custom_mode _slots[MaxCustomModes];
+				custom_mode* _entries;
+				uint8_t _size;
+				uint8_t _capacity;
+		};
+
+		Custom_modes _custom_modes;
+
+		/*
+		 * Output stage lookup tables for the linear buffer, allocated on the heap
+		 * only while a linear buffer is set. Row 0 scales a channel by the
+		 * brightness, row 1 gamma corrects it first.
+		 */
+		class Output_lut {
+			public:
+				Output_lut(void) : _table(NULL) {}
+				Output_lut(const Output_lut& other) : _table(NULL) {
+					*this = other;
+				}
+				~Output_lut(void) {
+					free(_table);
+				}
+				Output_lut& operator=(const Output_lut& other);
+
+				const uint8_t* operator[](uint8_t row) { return _table + (row ? 256 : 0); }
+				boolean build(uint8_t brightness); // false when out of memory
+				void release(void) { free(_table); _table = NULL; }
+				boolean isBuilt(void) { return _table != NULL; }
+
+			private:
+				uint8_t* _table;
+		};
+
+		Output_lut _output_lut;
+
+#if COMMAND_QUEUE_SIZE > 0
+		/*
+		 * Bounded queue of control changes. Any number of threads (or an ISR) can
+		 * push, service() is the only consumer. Lock-free where std::atomic is
+		 * available: a producer claims a cell with a compare-and-swap of the
+		 * enqueue position, fills it and publishes it through the cell's sequence
+		 * number (D. Vyukov's bounded MPMC queue, with a single consumer). AVR has
+		 * no atomics, there a push or pop just runs with interrupts disabled.
+		 * Copies of an instance start with an empty queue.
+		 */
+		class Command_queue {
+			public:
+				Command_queue(void) { clear(); }
+				Command_queue(const Command_queue&) { clear(); }
+				Command_queue& operator=(const Command_queue&) { return *this; }
+
+				boolean push(const command& c);
+				boolean pop(command& c); // consumer only
+				void clear(void);
+
+			private:
+#if defined(__AVR__)
+				typedef volatile uint16_t position;
+#else
+				typedef std::atomic<uint16_t> position;
+#endif
+				struct Cell {
+					position seq; // cell is free for the push at position seq, or holds the one at seq - 1
+					command cmd;
+				};
+				Cell _cells[COMMAND_QUEUE_SIZE];
+				position _enqueue;
+				uint16_t _dequeue;
 		};
+
+		Command_queue _commands;
+#else
+		boolean _commands_applied = false; // queueCommand() applied a change since the last service()
+#endif
+
+		/*
+		 * The engine's copy of the scene passed to setScene(), allocated on the
+		 * heap by the first setScene(). A producer claims the free slot, fills
+		 * it and queues CMD_SET_SCENE, service() installs it and frees the slot
+		 * again. Until then setScene() refuses the next scene. Copies of an
+		 * instance start with an empty slot.
+		 */
+		class Scene_slot {
+			public:
+				Scene_slot(void) : _scene(NULL), _state(SLOT_FREE) {}
+				Scene_slot(const Scene_slot&) : _scene(NULL), _state(SLOT_FREE) {}
+				Scene_slot& operator=(const Scene_slot&) { return *this; }
+				~Scene_slot(void) { free(_scene); }
+
+				scene_config* claim(void); // NULL if a scene is still waiting or out of memory
+				void queued(void) { _state = SLOT_QUEUED; }
+				void release(void) { _state = SLOT_FREE; }
+				boolean isFree(void) { return _state == SLOT_FREE; }
+				boolean isQueued(void) { return _state == SLOT_QUEUED; }
+				scene_config* scene(void) { return _scene; }
+
+			private:
+				enum { SLOT_FREE, SLOT_FILLING, SLOT_QUEUED };
+#if defined(__AVR__)
+				typedef volatile uint8_t state;
+#else
+				typedef std::atomic<uint8_t> state;
+#endif
+				scene_config* _scene;
+				state _state;
+		};
+
+		Scene_slot _scene_slot;
+		uint8_t _brightness;
+		uint8_t _color_order[3] = {0, 1, 2}; // source channel of each output byte
+		static uint16_t callNoContext(void* p) { return (reinterpret_cast<uint16_t (*)(void)>(p))(); }
+		static void callTimedNoContext(void* p, uint16_t elapsed, uint16_t phase) {
+			(reinterpret_cast<void (*)(uint16_t, uint16_t)>(p))(elapsed, phase);
+		}
 		void (*customShow)(void) = NULL;
+		boolean (*customShowBusy)(void) = NULL; // asynchronous show: true while a frame is still being sent
 
 		boolean
-			_running,
-			_triggered;
+			_running = false,
+			_triggered = false,
+			_show_pending = false;
 
-		mode_ptr _mode[MODE_COUNT]; // SRAM footprint: 4 bytes per element
-
-		uint8_t _segment_index = 0;
 		uint8_t _num_segments = 1;
-		segment _segments[MAX_NUM_SEGMENTS] = { // SRAM footprint: 20 bytes per element
-			// start, stop, speed, mode, options, color[]
-			{ 0, 7, DEFAULT_SPEED, FX_MODE_STATIC, NO_OPTIONS, {DEFAULT_COLOR, 0, 0}}
+		segment _segments[MaxSegments] = { // SRAM footprint: 23 bytes per element (AVR)
+			// start, stop, speed, mode, options, color[], palette, frame_rate
+			{ 0, 7, DEFAULT_SPEED, FX_MODE_STATIC, NO_OPTIONS, {DEFAULT_COLOR, 0, 0}, NULL, 0}
+		};
+		segment_runtime _segment_runtimes[MaxSegments]; // SRAM footprint: 18 bytes per element (AVR)
+
+		// segment scheduler: a min-heap of segment indexes ordered by next_time, so service()
+		// only has to look at the top of the heap to know if any segment is due
+		uint8_t _schedule[MaxSegments];
+		uint8_t _schedule_size = 0;
+		boolean _schedule_dirty = true; // rebuild the heap before the next service()
+		uint8_t _framed[MaxSegments]; // segments rendered by the last service() call
+		uint8_t _num_framed = 0;
+
+		output _outputs[MAX_NUM_OUTPUTS]; // SRAM footprint: 13 bytes per element (AVR)
+		uint8_t _num_outputs = 0;
+		unsigned long _now = 0; // time of the current service() call
+
+		// custom effect scratch memory, the segments' blocks are packed at the start of the arena
+		uint64_t _scratch[ScratchSize ? (ScratchSize + 7) / 8 : 1];
+		uint16_t _scratch_used = 0;
+		uint16_t _scratch_offset[MaxSegments];
+		uint16_t _scratch_size[MaxSegments] = {}; // 0: the segment has no block
+
+		// duplicate frame suppression
+		boolean _suppress_duplicates = false;
+		boolean _last_frame_valid = false;
+		uint32_t _last_frame_hash = 0;
+		uint32_t _suppressed_frames = 0;
+
+		void
+			rebuildSchedule(void),
+			schedulePush(uint8_t seg),
+			scheduleSiftDown(uint8_t pos);
+		uint8_t
+			schedulePop(void);
+		uint16_t runMode(void);
+		void renderSegment(uint8_t seg);
+		void showOutputs(void);
+		unsigned long timeToPendingShow(unsigned long now);
+		void swapBuffers(void);
+		boolean applyCommands(void);
+		void applyBrightness(uint8_t b);
+		void installScene(const scene_config& s);
+		void applyCommand(const command& c);
+		void pointControllers(struct CRGB* from, struct CRGB* to);
+		uint16_t advancePhase(void);
+		void catchUp(unsigned long now);
+#ifdef WS2812FX_THREADS
+		boolean framedOverlap(void);
+		static void renderTask(void* p, uint8_t task);
+		void compactScratch(void);
+#endif
+
+		void releaseScratch(uint8_t seg);
+		void writePixel(uint16_t n, uint8_t r, uint8_t g, uint8_t b);
+		CRGB toPixel(uint32_t c, boolean gamma);
+		static boolean samePixel(const CRGB& a, const CRGB& b);
+		static uint32_t blendPacked(uint32_t a, uint32_t b, uint8_t amount);
+
+		// segment options as compile time constants, one kernel instantiation per combination
+		template<bool Reverse, bool Gamma, uint8_t SizeOption>
+		struct Fixed_options {
+			bool reverse(void) const { return Reverse; }
+			bool gamma(void) const { return Gamma; }
+			uint8_t size(void) const { return SizeOption; }
+		};
+		// segment options read once per frame, for GENERIC_KERNELS
+		struct Frame_options {
+			bool _reverse, _gamma;
+			uint8_t _size;
+			bool reverse(void) const { return _reverse; }
+			bool gamma(void) const { return _gamma; }
+			uint8_t size(void) const { return _size; }
 		};
-		segment_runtime _segment_runtimes[MAX_NUM_SEGMENTS]; // SRAM footprint: 16 bytes per element
+
+		template<typename Opt> void putPixel(Opt o, uint16_t n, uint32_t c);
+		template<typename Opt> void putPixel(Opt o, uint16_t n, uint8_t r, uint8_t g, uint8_t b);
+		template<typename Opt> uint16_t chase_kernel(Opt o, uint32_t color1, uint32_t color2, uint32_t color3);
+		template<typename Opt> uint16_t running_kernel(Opt o, uint32_t color1, uint32_t color2);
+		template<typename Opt> uint16_t tricolor_chase_kernel(Opt o, uint32_t color1, uint32_t color2, uint32_t color3);
+		template<typename Opt> uint16_t scan_kernel(Opt o, uint32_t color1, uint32_t color2, bool dual);
+		template<typename Opt> uint16_t color_wipe_kernel(Opt o, uint32_t color1, uint32_t color2, bool rev, uint32_t steps);
+		template<typename Opt> uint16_t running_lights_kernel(Opt o, uint32_t color);
+		void hueRamp(uint8_t seg, uint16_t hue16, uint16_t step16, uint16_t stepRem, uint16_t den);
+		static uint8_t fadeChannel(uint8_t c, uint8_t target, uint8_t rate, uint8_t rateH, uint8_t rateL);
+		uint32_t frameHash(void);
+		void
+			writeOutput(void),
+			writeOutput(const uint8_t* lut, uint16_t first, uint16_t last);
 };
 
+#include "WS2812FX_impl.h"
+
+// the default configuration is compiled once, in WS2812FX.cpp
+extern template class WS2812FXT<MAX_NUM_SEGMENTS, NUM_COLORS, MAX_CUSTOM_MODES, SCRATCH_SIZE>;
+
+typedef WS2812FXT<MAX_NUM_SEGMENTS, NUM_COLORS, MAX_CUSTOM_MODES, SCRATCH_SIZE> WS2812FX;
+
 #endif
@@ -0,0 +1,3359 @@
+/*
+  WS2812FX_impl.h - Library for WS2812 LED effects.
+
+  Member definitions of the WS2812FXT class template. Included at the end of
+  WS2812FX.h, don't include this file directly.
+
+  Harm Aldick - 2016
+  www.aldick.org
+
+
+  FEATURES
+    * A lot of blinken modes and counting
+    * WS2812FX can be used as drop-in replacement for Adafruit NeoPixel Library
+
+  NOTES
+    * Uses the Adafruit NeoPixel library. Get it here:
+      https://github.com/adafruit/Adafruit_NeoPixel
+
+
+
+  LICENSE
+
+  The MIT License (MIT)
+
+  Copyright (c) 2016  Harm Aldick
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+
+
+  CHANGELOG
+
+  2016-05-28   Initial beta release
+  2016-06-03   Code cleanup, minor improvements, new modes
+  2016-06-04   2 new fx, fixed setColor (now also resets _mode_color)
+  2017-02-02   added external trigger functionality (e.g. for sound-to-light)
+  2017-02-02   removed "blackout" on mode, speed or color-change
+  2017-09-26   implemented segment and reverse features
+  2017-11-16   changed speed calc, reduced memory footprint
+  2018-02-24   added hooks for user created custom effects
+*/
+
+#ifndef WS2812FX_impl_h
+#define WS2812FX_impl_h
+
+#include <limits.h>
+
+#define WS2812FX_TEMPLATE template<uint8_t MaxSegments, uint8_t NumColors, uint8_t MaxCustomModes, uint16_t ScratchSize>
+#define WS2812FX_T        WS2812FXT<MaxSegments, NumColors, MaxCustomModes, ScratchSize>
+
+/*
+ * The builtin mode table, indexed by mode id. It is a static member, so it is
+ * stored in flash once per configuration instead of in every instance's SRAM.
+ */
+// if flash memory is constrained (I'm looking at you Arduino Nano), replace modes
+// that use a lot of flash with mode_static (reduces flash footprint by about 2100 bytes)
+#ifdef REDUCED_MODES
+  #define MODE_FN(f) &WS2812FX_T::mode_static, MODE_REDUCED
+#else
+  #define MODE_FN(f) &WS2812FX_T::f, MODE_NO_FLAGS
+#endif
+#define TIMED_FN(f) &WS2812FX_T::template timed<&WS2812FX_T::f>, MODE_TIMED
+WS2812FX_TEMPLATE
+const typename WS2812FX_T::mode_descriptor WS2812FX_T::_modes[FX_MODE_CUSTOM_0] PROGMEM = {
+  { name_0,  &WS2812FX_T::mode_static, MODE_NO_FLAGS              }, // FX_MODE_STATIC
+  { name_1,  &WS2812FX_T::mode_blink, MODE_NO_FLAGS               }, // FX_MODE_BLINK
+  { name_2,  MODE_FN(mode_breath)                                 }, // FX_MODE_BREATH
+  { name_3,  &WS2812FX_T::mode_color_wipe, MODE_NO_FLAGS          }, // FX_MODE_COLOR_WIPE
+  { name_4,  &WS2812FX_T::mode_color_wipe_inv, MODE_NO_FLAGS      }, // FX_MODE_COLOR_WIPE_INV
+  { name_5,  &WS2812FX_T::mode_color_wipe_rev, MODE_NO_FLAGS      }, // FX_MODE_COLOR_WIPE_REV
+  { name_6,  &WS2812FX_T::mode_color_wipe_rev_inv, MODE_NO_FLAGS  }, // FX_MODE_COLOR_WIPE_REV_INV
+  { name_7,  &WS2812FX_T::mode_color_wipe_random, MODE_NO_FLAGS   }, // FX_MODE_COLOR_WIPE_RANDOM
+  { name_8,  &WS2812FX_T::mode_random_color, MODE_NO_FLAGS        }, // FX_MODE_RANDOM_COLOR
+  { name_9,  &WS2812FX_T::mode_single_dynamic, MODE_NO_FLAGS      }, // FX_MODE_SINGLE_DYNAMIC
+  { name_10, &WS2812FX_T::mode_multi_dynamic, MODE_NO_FLAGS       }, // FX_MODE_MULTI_DYNAMIC
+  { name_11, TIMED_FN(mode_rainbow)                               }, // FX_MODE_RAINBOW
+  { name_12, TIMED_FN(mode_rainbow_cycle)                         }, // FX_MODE_RAINBOW_CYCLE
+  { name_13, &WS2812FX_T::mode_scan, MODE_NO_FLAGS                }, // FX_MODE_SCAN
+  { name_14, &WS2812FX_T::mode_dual_scan, MODE_NO_FLAGS           }, // FX_MODE_DUAL_SCAN
+  { name_15, TIMED_FN(mode_fade)                                  }, // FX_MODE_FADE
+  { name_16, &WS2812FX_T::mode_theater_chase, MODE_NO_FLAGS       }, // FX_MODE_THEATER_CHASE
+  { name_17, &WS2812FX_T::mode_theater_chase_rainbow, MODE_NO_FLAGS }, // FX_MODE_THEATER_CHASE_RAINBOW
+  { name_18, MODE_FN(mode_running_lights)                         }, // FX_MODE_RUNNING_LIGHTS
+  { name_19, &WS2812FX_T::mode_twinkle, MODE_NO_FLAGS             }, // FX_MODE_TWINKLE
+  { name_20, &WS2812FX_T::mode_twinkle_random, MODE_NO_FLAGS      }, // FX_MODE_TWINKLE_RANDOM
+  { name_21, &WS2812FX_T::mode_twinkle_fade, MODE_NO_FLAGS        }, // FX_MODE_TWINKLE_FADE
+  { name_22, &WS2812FX_T::mode_twinkle_fade_random, MODE_NO_FLAGS }, // FX_MODE_TWINKLE_FADE_RANDOM
+  { name_23, &WS2812FX_T::mode_sparkle, MODE_NO_FLAGS             }, // FX_MODE_SPARKLE
+  { name_24, &WS2812FX_T::mode_flash_sparkle, MODE_NO_FLAGS       }, // FX_MODE_FLASH_SPARKLE
+  { name_25, &WS2812FX_T::mode_hyper_sparkle, MODE_NO_FLAGS       }, // FX_MODE_HYPER_SPARKLE
+  { name_26, &WS2812FX_T::mode_strobe, MODE_NO_FLAGS              }, // FX_MODE_STROBE
+  { name_27, &WS2812FX_T::mode_strobe_rainbow, MODE_NO_FLAGS      }, // FX_MODE_STROBE_RAINBOW
+  { name_28, &WS2812FX_T::mode_multi_strobe, MODE_NO_FLAGS        }, // FX_MODE_MULTI_STROBE
+  { name_29, &WS2812FX_T::mode_blink_rainbow, MODE_NO_FLAGS       }, // FX_MODE_BLINK_RAINBOW
+  { name_30, &WS2812FX_T::mode_chase_white, MODE_NO_FLAGS         }, // FX_MODE_CHASE_WHITE
+  { name_31, &WS2812FX_T::mode_chase_color, MODE_NO_FLAGS         }, // FX_MODE_CHASE_COLOR
+  { name_32, &WS2812FX_T::mode_chase_random, MODE_NO_FLAGS        }, // FX_MODE_CHASE_RANDOM
+  { name_33, &WS2812FX_T::mode_chase_rainbow, MODE_NO_FLAGS       }, // FX_MODE_CHASE_RAINBOW
+  { name_34, &WS2812FX_T::mode_chase_flash, MODE_NO_FLAGS         }, // FX_MODE_CHASE_FLASH
+  { name_35, &WS2812FX_T::mode_chase_flash_random, MODE_NO_FLAGS  }, // FX_MODE_CHASE_FLASH_RANDOM
+  { name_36, &WS2812FX_T::mode_chase_rainbow_white, MODE_NO_FLAGS }, // FX_MODE_CHASE_RAINBOW_WHITE
+  { name_37, &WS2812FX_T::mode_chase_blackout, MODE_NO_FLAGS      }, // FX_MODE_CHASE_BLACKOUT
+  { name_38, &WS2812FX_T::mode_chase_blackout_rainbow, MODE_NO_FLAGS }, // FX_MODE_CHASE_BLACKOUT_RAINBOW
+  { name_39, &WS2812FX_T::mode_color_sweep_random, MODE_NO_FLAGS  }, // FX_MODE_COLOR_SWEEP_RANDOM
+  { name_40, &WS2812FX_T::mode_running_color, MODE_NO_FLAGS       }, // FX_MODE_RUNNING_COLOR
+  { name_41, &WS2812FX_T::mode_running_red_blue, MODE_NO_FLAGS    }, // FX_MODE_RUNNING_RED_BLUE
+  { name_42, &WS2812FX_T::mode_running_random, MODE_NO_FLAGS      }, // FX_MODE_RUNNING_RANDOM
+  { name_43, &WS2812FX_T::mode_larson_scanner, MODE_NO_FLAGS      }, // FX_MODE_LARSON_SCANNER
+  { name_44, &WS2812FX_T::mode_comet, MODE_NO_FLAGS               }, // FX_MODE_COMET
+  { name_45, &WS2812FX_T::mode_fireworks, MODE_NO_FLAGS           }, // FX_MODE_FIREWORKS
+  { name_46, &WS2812FX_T::mode_fireworks_random, MODE_NO_FLAGS    }, // FX_MODE_FIREWORKS_RANDOM
+  { name_47, &WS2812FX_T::mode_merry_christmas, MODE_NO_FLAGS     }, // FX_MODE_MERRY_CHRISTMAS
+  { name_48, &WS2812FX_T::mode_fire_flicker, MODE_NO_FLAGS        }, // FX_MODE_FIRE_FLICKER
+  { name_49, &WS2812FX_T::mode_fire_flicker_soft, MODE_NO_FLAGS   }, // FX_MODE_FIRE_FLICKER_SOFT
+  { name_50, &WS2812FX_T::mode_fire_flicker_intense, MODE_NO_FLAGS }, // FX_MODE_FIRE_FLICKER_INTENSE
+  { name_51, &WS2812FX_T::mode_circus_combustus, MODE_NO_FLAGS    }, // FX_MODE_CIRCUS_COMBUSTUS
+  { name_52, &WS2812FX_T::mode_halloween, MODE_NO_FLAGS           }, // FX_MODE_HALLOWEEN
+  { name_53, &WS2812FX_T::mode_bicolor_chase, MODE_NO_FLAGS       }, // FX_MODE_BICOLOR_CHASE
+  { name_54, &WS2812FX_T::mode_tricolor_chase, MODE_NO_FLAGS      }, // FX_MODE_TRICOLOR_CHASE
+  { name_55, MODE_FN(mode_icu)                                    }, // FX_MODE_ICU
+};
+#undef MODE_FN
+#undef TIMED_FN
+
+/*
+ * Option specialized kernels. The helpers below are member templates over the
+ * segment's REVERSE, GAMMA and SIZE options, DISPATCH_KERNEL picks the
+ * instantiation that matches the current segment once per frame, so the pixel
+ * loops don't test the options (or look up the segment) for every pixel.
+ * With GENERIC_KERNELS there is a single instantiation that reads the options
+ * once per frame.
+ */
+#ifdef GENERIC_KERNELS
+  #define DISPATCH_KERNEL(kernel, ...) \
+    Frame_options o = { IS_REVERSE, IS_GAMMA && _frame == ledArray, (uint8_t)SIZE_OPTION }; \
+    return kernel(o, __VA_ARGS__);
+#else
+  #define KERNEL_CASE(kernel, r, g, s, ...) \
+    case ((r << 3) | (g << 2) | s): return kernel(Fixed_options<r, g, s>(), __VA_ARGS__);
+  #define KERNEL_CASES(kernel, r, g, ...) \
+    KERNEL_CASE(kernel, r, g, 0, __VA_ARGS__) \
+    KERNEL_CASE(kernel, r, g, 1, __VA_ARGS__) \
+    KERNEL_CASE(kernel, r, g, 2, __VA_ARGS__) \
+    KERNEL_CASE(kernel, r, g, 3, __VA_ARGS__)
+  #define DISPATCH_KERNEL(kernel, ...) \
+    switch((IS_REVERSE << 3) | ((IS_GAMMA && _frame == ledArray) << 2) | SIZE_OPTION) { \
+      KERNEL_CASES(kernel, 0, 0, __VA_ARGS__) \
+      KERNEL_CASES(kernel, 0, 1, __VA_ARGS__) \
+      KERNEL_CASES(kernel, 1, 0, __VA_ARGS__) \
+      default: \
+      KERNEL_CASES(kernel, 1, 1, __VA_ARGS__) \
+    }
+#endif
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::init() {
+  resetSegmentRuntimes();
+  strip_off();
+  
+  // Adafruit_NeoPixel::begin();
+}
+
+// void WS2812FX::timer() {
+//     for (int j=0; j < 1000; j++) {
+//       uint16_t delay = (this->*_modes[SEGMENT.mode].fn)();
+//     }
+// }
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::service() {
+  boolean applied = applyCommands(); // control changes queued since the last call
+  if(_show_pending) show(); // the last frame was rendered while the output was still busy
+
+  if(_running || _triggered) {
+    unsigned long now = millis(); // Be aware, millis() rolls over every 49 days
+    _now = now;
+
+    // only the segments rendered by the previous call can have their FRAME flag set
+    for(uint8_t i=0; i < _num_framed; i++) {
+      _segment_runtimes[_framed[i]].aux_param2 &= ~FRAME;
+    }
+    _num_framed = 0;
+
+    if(_triggered) { // render every segment
+      for(uint8_t i=0; i < _num_segments; i++) {
+        _framed[_num_framed++] = i;
+      }
+      _schedule_dirty = true;
+    } else {
+      if(_schedule_dirty) rebuildSchedule();
+      // pop only the segments that are due, the common case (nothing due) is O(1)
+      while(_schedule_size > 0 && now > _segment_runtimes[_schedule[0]].next_time) {
+        _framed[_num_framed++] = schedulePop();
+      }
+    }
+
+    if(_num_framed > 0) {
+      // render due segments in index order, so overlapping segments are drawn as before
+      for(uint8_t i=1; i < _num_framed; i++) {
+        uint8_t seg = _framed[i];
+        int16_t j = i - 1;
+        while(j >= 0 && _framed[j] > seg) {
+          _framed[j + 1] = _framed[j];
+          j--;
+        }
+        _framed[j + 1] = seg;
+      }
+
+#ifdef WS2812FX_THREADS
+      if(_render_threads > 1 && _num_framed > 1 && !framedOverlap()) {
+        WS2812FX_pool::instance().run(renderTask, this, _num_framed);
+        _render.segment_index = _framed[_num_framed - 1];
+        random16(); // the next frame's tasks start from other seeds
+        if(_scratch_gaps) compactScratch();
+      } else
+#endif
+      for(uint8_t i=0; i < _num_framed; i++) {
+        renderSegment(_framed[i]);
+      }
+
+      // a mode function may have changed the segment setup, otherwise just re-queue the rendered segments
+      if(!_schedule_dirty) {
+        for(uint8_t i=0; i < _num_framed; i++) {
+          schedulePush(_framed[i]);
+        }
+      }
+
+      if(isDirty()) { // skip the transmission if no pixel actually changed
+#if defined(ESP32) && defined(ESP32_SHOW_DELAY)
+        delay(ESP32_SHOW_DELAY);
+#endif
+        show();
+      }
+    }
+    _triggered = false;
+  }
+
+  // a queued change no segment was rendered for (e.g. the brightness, or any change on a stopped strip)
+  if(applied && isDirty()) show();
+}
+
+// renders the segment's frame and schedules its next one
+WS2812FX_TEMPLATE
+void WS2812FX_T::renderSegment(uint8_t seg) {
+  RENDER_STATE.segment_index = seg;
+  SET_FRAME;
+  RENDER_STATE.step_time = 0;
+  uint16_t delay = runMode();
+  SEGMENT_RUNTIME.counter_mode_call++;
+  if(RENDER_STATE.step_time != 0) { // steps faster than SPEED_MIN, render every step due in this frame
+    catchUp(_now);
+  } else {
+    SEGMENT_RUNTIME.next_time = _now + max(delay, SPEED_MIN);
+    SEGMENT_RUNTIME.step_frac = 0;
+  }
+}
+
+#ifdef WS2812FX_THREADS
+WS2812FX_TEMPLATE
+thread_local typename WS2812FX_T::render_state* WS2812FX_T::_task_state = NULL;
+
+// true if two of the segments due in this frame share LEDs, they are rendered one after another then
+WS2812FX_TEMPLATE
+boolean WS2812FX_T::framedOverlap() {
+  for(uint8_t i=0; i < _num_framed; i++) {
+    segment& a = _segments[_framed[i]];
+    for(uint8_t j=i+1; j < _num_framed; j++) {
+      segment& b = _segments[_framed[j]];
+      if(a.start <= b.stop && b.start <= a.stop) return true;
+    }
+  }
+  return false;
+}
+
+/*
+ * Pool task: renders one due segment with a render state of its own and adds
+ * the pixels it changed to the instance's dirty span.
+ */
+WS2812FX_TEMPLATE
+void WS2812FX_T::renderTask(void* p, uint8_t task) {
+  WS2812FX_T* fx = static_cast<WS2812FX_T*>(p);
+  render_state state;
+  state.owner = fx;
+  state.rand16seed = fx->_render.rand16seed + task * 40503U; // a random sequence per task
+  render_state* outer = _task_state;
+  _task_state = &state;
+  fx->renderSegment(fx->_framed[task]);
+  _task_state = outer;
+
+  std::lock_guard<std::mutex> lock(WS2812FX_pool::instance().mutex());
+  fx->_render.dirty_start = min(fx->_render.dirty_start, state.dirty_start);
+  fx->_render.dirty_stop  = max(fx->_render.dirty_stop,  state.dirty_stop);
+#ifdef WS2812FX_STATS
+  fx->_render.pixel_writes += state.pixel_writes;
+#endif
+}
+#endif
+
+// renders one step of the current segment's mode
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::runMode() {
+  if(SEGMENT.mode < FX_MODE_CUSTOM_0) {
+    mode_ptr fn;
+    memcpy_P(&fn, &_modes[SEGMENT.mode].fn, sizeof(fn));
+    return (this->*fn)();
+  }
+  return mode_custom();
+}
+
+/*
+ * Timed modes (MODE_TIMED) don't count steps, they get the time since their last
+ * frame and the segment's phase, its position in the current 'speed' ms cycle
+ * (0-65535), and are called getFrameInterval() ms apart. So they look the same at
+ * any frame rate. The phase is kept in counter_mode_step (2^32 per cycle), the
+ * last frame was rendered one frame interval before next_time.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::advancePhase() {
+  uint32_t elapsed = 0;
+  if(SEGMENT_RUNTIME.counter_mode_call != 0) { // the first frame starts at phase 0
+    elapsed = _now - (SEGMENT_RUNTIME.next_time - getFrameInterval(RENDER_STATE.segment_index));
+  }
+  SEGMENT_RUNTIME.counter_mode_step += elapsed * (UINT32_MAX / max(SEGMENT.speed, (uint16_t)1));
+  return min(elapsed, (uint32_t)UINT16_MAX);
+}
+
+WS2812FX_TEMPLATE template<typename WS2812FX_T::timed_mode_ptr F>
+uint16_t WS2812FX_T::timed() {
+  uint16_t elapsed = advancePhase();
+  (this->*F)(elapsed, SEGMENT_RUNTIME.counter_mode_step >> 16);
+  return getFrameInterval(RENDER_STATE.segment_index);
+}
+
+/*
+ * Multi-step catch-up for a mode that steps faster than SPEED_MIN (see stepDelay()).
+ * The step just rendered was due at next_time + step_frac, the following steps are
+ * rendered in one go as long as they fall before the segment's next frame, so the
+ * animation runs at the configured speed whatever the segment length and show()
+ * sends the result once. Modes whose pixels are a function of the step counter skip
+ * drawing the intermediate steps (catch_up).
+ */
+WS2812FX_TEMPLATE
+void WS2812FX_T::catchUp(unsigned long now) {
+  unsigned long horizon = now + SPEED_MIN; // the segment's next frame
+  uint8_t cycle = SEGMENT_RUNTIME.aux_param2 & CYCLE;
+
+  // due time of the next step, in ms + 1/65536 ms
+  uint32_t frac = SEGMENT_RUNTIME.step_frac + RENDER_STATE.step_time;
+  unsigned long due = SEGMENT_RUNTIME.next_time + (frac >> 16);
+  frac &= 0xFFFF;
+  if((long)(now - due) > (long)(((uint32_t)MAX_CATCHUP_STEPS * RENDER_STATE.step_time) >> 16)) {
+    due = now; // too far behind (just started, service() wasn't called for a while), skip ahead
+    frac = 0;
+  }
+
+  for(uint16_t steps = 1; (long)(due - horizon) < 0 && steps < MAX_CATCHUP_STEPS; steps++) {
+    uint32_t next = frac + RENDER_STATE.step_time;
+    RENDER_STATE.catch_up = (long)(due + (next >> 16) - horizon) < 0 && steps + 1 < MAX_CATCHUP_STEPS;
+    RENDER_STATE.step_time = 0;
+    uint16_t delay = runMode();
+    SEGMENT_RUNTIME.counter_mode_call++;
+    cycle |= SEGMENT_RUNTIME.aux_param2 & CYCLE;
+    if(RENDER_STATE.step_time == 0) { // the mode slowed down (e.g. a pause), back to one step per frame
+      due = now + max(delay, SPEED_MIN);
+      frac = 0;
+      break;
+    }
+    frac += RENDER_STATE.step_time;
+    due += frac >> 16;
+    frac &= 0xFFFF;
+  }
+  RENDER_STATE.catch_up = false;
+
+  SEGMENT_RUNTIME.aux_param2 |= cycle; // a cycle completed by any of the steps
+  SEGMENT_RUNTIME.next_time = due;
+  SEGMENT_RUNTIME.step_frac = frac;
+}
+
+/*
+ * Delay for a mode that takes 'steps' steps per speed cycle (e.g. one step per LED).
+ * If that's shorter than SPEED_MIN, service() renders several steps per frame instead
+ * of dropping to SPEED_MIN per step, so a cycle takes 'speed' ms on any segment length.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::stepDelay(uint32_t steps) {
+  uint16_t delay = SEGMENT.speed / steps;
+  if(delay < SPEED_MIN) {
+    RENDER_STATE.step_time = ((uint32_t)SEGMENT.speed << 16) / steps;
+  }
+  return delay;
+}
+
+/*
+ * Stores a pixel and, if its color actually changed, grows the dirty span that
+ * the next show() has to send. Rewriting a pixel with the same color is free.
+ */
+WS2812FX_TEMPLATE
+inline void WS2812FX_T::writePixel(uint16_t n, uint8_t r, uint8_t g, uint8_t b) {
+  CRGB& pixel = _frame[n];
+  if(pixel.r != r || pixel.g != g || pixel.b != b) {
+    pixel.setRGB(r, g, b);
+    if(n < RENDER_STATE.dirty_start) RENDER_STATE.dirty_start = n;
+    if(n > RENDER_STATE.dirty_stop)  RENDER_STATE.dirty_stop  = n;
+  }
+}
+
+// overload setPixelColor() functions so we can use gamma correction
+// (see https://learn.adafruit.com/led-tricks-gamma-correction/the-issue)
+WS2812FX_TEMPLATE
+void WS2812FX_T::setPixelColor(uint16_t n, uint32_t c) {
+#ifdef WS2812FX_STATS
+  RENDER_STATE.pixel_writes++;
+#endif
+  if(IS_GAMMA && _frame == ledArray) { // a linear buffer is gamma corrected by show()
+    uint8_t w = (c >> 24) & 0xFF;
+    uint8_t g = (c >> 16) & 0xFF;
+    uint8_t r = (c >>  8) & 0xFF;
+    uint8_t b =  c        & 0xFF;
+    writePixel(n, gamma8(r), gamma8(g), gamma8(b));
+    // Adafruit_NeoPixel::setPixelColor(n, gamma8(r), gamma8(g), gamma8(b), gamma8(w));
+  } else {
+    uint8_t w = (c >> 24) & 0xFF;
+    uint8_t g = (c >> 16) & 0xFF;
+    uint8_t r = (c >>  8) & 0xFF;
+    uint8_t b =  c        & 0xFF;
+    writePixel(n, r, g, b);
+    // Adafruit_NeoPixel::setPixelColor(n, c);
+  }
+}
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b) {
+#ifdef WS2812FX_STATS
+  RENDER_STATE.pixel_writes++;
+#endif
+  if(IS_GAMMA && _frame == ledArray) { // a linear buffer is gamma corrected by show()
+    writePixel(n, gamma8(r), gamma8(g), gamma8(b));
+    // Adafruit_NeoPixel::setPixelColor(n, gamma8(r), gamma8(g), gamma8(b));
+  } else {
+    writePixel(n, r, g, b);
+    // Adafruit_NeoPixel::setPixelColor(n, r, g, b);
+  }
+}
+
+// We ignore the W channel like
+WS2812FX_TEMPLATE
+void WS2812FX_T::setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b, uint8_t w) {
+#ifdef WS2812FX_STATS
+  RENDER_STATE.pixel_writes++;
+#endif
+  if(IS_GAMMA && _frame == ledArray) { // a linear buffer is gamma corrected by show()
+    writePixel(n, gamma8(r), gamma8(g), gamma8(b));
+    // Adafruit_NeoPixel::setPixelColor(n, gamma8(r), gamma8(g), gamma8(b));
+  } else {
+    writePixel(n, r, g, b);
+    // Adafruit_NeoPixel::setPixelColor(n, r, g, b);
+  }
+}
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::copyPixels(uint16_t dest, uint16_t src, uint16_t count) {
+  uint8_t *pixels = (uint8_t*)_frame;
+  uint8_t bytesPerPixel = getNumBytesPerPixel(); // 3=RGB, 4=RGBW
+
+  memmove(pixels + (dest * bytesPerPixel), pixels + (src * bytesPerPixel), count * bytesPerPixel);
+  if(count > 0) setDirty(dest, dest + count - 1);
+}
+
+/*
+ * Span writes. These look up the segment and its options once and then write
+ * the LED array directly, instead of going through setPixelColor() for every
+ * pixel. Like setPixelColor(), only the pixels that actually change are marked
+ * dirty.
+ */
+
+// the color as it's stored in the LED array, same channel order as setPixelColor()
+WS2812FX_TEMPLATE
+inline CRGB WS2812FX_T::toPixel(uint32_t c, boolean gamma) {
+  uint8_t g = (c >> 16) & 0xFF;
+  uint8_t r = (c >>  8) & 0xFF;
+  uint8_t b =  c        & 0xFF;
+  if(gamma) return CRGB(gamma8(r), gamma8(g), gamma8(b));
+  return CRGB(r, g, b);
+}
+
+WS2812FX_TEMPLATE
+inline boolean WS2812FX_T::samePixel(const CRGB& a, const CRGB& b) {
+  return a.r == b.r && a.g == b.g && a.b == b.b;
+}
+
+// sets every pixel of segment 'seg' to color 'c'
+WS2812FX_TEMPLATE
+void WS2812FX_T::fill(uint8_t seg, uint32_t c) {
+  fillPattern(seg, &c, 1);
+}
+
+// repeats the 'len' colors of 'pattern' over segment 'seg', starting at the segment's first pixel
+WS2812FX_TEMPLATE
+void WS2812FX_T::fillPattern(uint8_t seg, const uint32_t* pattern, uint8_t len) {
+  if(len == 0 || len > MAX_PATTERN_LENGTH) return;
+  uint16_t start = _segments[seg].start;
+  uint16_t stop = min(_segments[seg].stop, (uint16_t)(numLEDs - 1));
+  if(start > stop) return;
+  uint16_t n = stop - start + 1;
+#ifdef WS2812FX_STATS
+  RENDER_STATE.pixel_writes += n;
+#endif
+
+  CRGB period[MAX_PATTERN_LENGTH];
+  boolean gamma = (_segments[seg].options & GAMMA) == GAMMA && _frame == ledArray;
+  for(uint8_t i=0; i < len; i++) {
+    period[i] = toPixel(pattern[i], gamma);
+  }
+
+  // find the first and the last pixel that change, leave the ones around them alone
+  CRGB* leds = _frame + start;
+  uint16_t first = 0;
+  uint8_t p = 0;
+  while(first < n && samePixel(leds[first], period[p])) {
+    first++;
+    if(++p == len) p = 0;
+  }
+  if(first == n) return; // nothing changes
+
+  uint16_t last = n - 1;
+  p = last % len;
+  while(samePixel(leds[last], period[p])) {
+    last--;
+    p = (p == 0) ? len - 1 : p - 1;
+  }
+
+  // write one period, then keep doubling the written part with memcpy()
+  CRGB* dest = leds + first;
+  uint16_t count = last - first + 1;
+  uint16_t done = min((uint16_t)len, count);
+  p = first % len;
+  for(uint16_t i=0; i < done; i++) {
+    dest[i] = period[p];
+    if(++p == len) p = 0;
+  }
+  while(done < count) { // 'done' is a multiple of the period, so the pattern stays in phase
+    uint16_t chunk = min(done, (uint16_t)(count - done));
+    memcpy(dest + done, dest, chunk * sizeof(CRGB));
+    done += chunk;
+  }
+  setDirty(start + first, start + last);
+}
+
+// writes the 'count' colors to segment 'seg', starting at pixel 'offset' of the segment
+WS2812FX_TEMPLATE
+void WS2812FX_T::writeSpan(uint8_t seg, uint16_t offset, const uint32_t* colors, uint16_t count) {
+  uint16_t start = _segments[seg].start + offset;
+  uint16_t stop = min(_segments[seg].stop, (uint16_t)(numLEDs - 1));
+  if(count == 0 || start > stop) return;
+  count = min(count, (uint16_t)(stop - start + 1));
+#ifdef WS2812FX_STATS
+  RENDER_STATE.pixel_writes += count;
+#endif
+
+  boolean gamma = (_segments[seg].options & GAMMA) == GAMMA && _frame == ledArray;
+  CRGB* leds = _frame + start;
+  int32_t first = -1, last = -1;
+  for(uint16_t i=0; i < count; i++) {
+    CRGB pixel = toPixel(colors[i], gamma);
+    if(!samePixel(leds[i], pixel)) {
+      leds[i] = pixel;
+      if(first < 0) first = i;
+      last = i;
+    }
+  }
+  if(first >= 0) setDirty(start + first, start + last);
+}
+
+/*
+ * Fills segment 'seg' with colors from its palette (the color wheel by default). The first pixel gets startHue,
+ * every next pixel advances the hue by hueStep16 / 256 (8.8 fixed point), so
+ * hueStep16 = 256 is one wheel position per pixel and 65536 / length spreads
+ * one turn of the wheel over the segment. No division per pixel.
+ */
+WS2812FX_TEMPLATE
+void WS2812FX_T::hueRamp(uint8_t seg, uint8_t startHue, uint16_t hueStep16) {
+  hueRamp(seg, (uint16_t)startHue << 8, hueStep16, 0, 1);
+}
+
+// hue ramp with a step of (step16 + stepRem / den) / 256 hues per pixel, the
+// remainder is carried like in Bresenham's line algorithm so long ramps don't drift
+WS2812FX_TEMPLATE
+void WS2812FX_T::hueRamp(uint8_t seg, uint16_t hue16, uint16_t step16, uint16_t stepRem, uint16_t den) {
+  uint16_t length = _segments[seg].stop - _segments[seg].start + 1;
+  const palette16* palette = _segments[seg].palette;
+  uint32_t colors[MAX_PATTERN_LENGTH];
+  uint32_t rem = 0;
+  for(uint16_t offset=0; offset < length; offset += MAX_PATTERN_LENGTH) {
+    uint16_t n = min((uint16_t)MAX_PATTERN_LENGTH, (uint16_t)(length - offset));
+    for(uint16_t i=0; i < n; i++) {
+      colors[i] = palette_color(palette, hue16 >> 8);
+      hue16 += step16;
+      rem += stepRem;
+      if(rem >= den) {
+        rem -= den;
+        hue16++;
+      }
+    }
+    writeSpan(seg, offset, colors, n);
+  }
+}
+
+/*
+ * Blends color arrays like color_blend() does one pair of colors:
+ * dest[i] = blend of a[i] and b[i] by 'amount' (blendSpan()) or by amounts[i]
+ * (blendSpans()). dest may be a or b. The results can be written to a segment
+ * with writeSpan().
+ */
+WS2812FX_TEMPLATE
+void WS2812FX_T::blendSpan(uint32_t* dest, const uint32_t* a, const uint32_t* b, uint8_t amount, uint16_t n) {
+  if(amount == 0) {
+    if(dest != a) memmove(dest, a, n * sizeof(uint32_t));
+  } else if(amount == 255) {
+    if(dest != b) memmove(dest, b, n * sizeof(uint32_t));
+  } else {
+    for(uint16_t i=0; i < n; i++) {
+      dest[i] = blendPacked(a[i], b[i], amount);
+    }
+  }
+}
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::blendSpans(uint32_t* dest, const uint32_t* a, const uint32_t* b, const uint8_t* amounts, uint16_t n) {
+  for(uint16_t i=0; i < n; i++) {
+    uint8_t amount = amounts[i];
+    dest[i] = (amount == 0) ? a[i] : (amount == 255) ? b[i] : blendPacked(a[i], b[i], amount);
+  }
+}
+
+/*
+ * Blends all four channels of a packed color with two multiplies per operand:
+ * the channels are split into two pairs of 16 bit lanes, which can't overflow
+ * into each other because 255 * 255 < 65536.
+ */
+WS2812FX_TEMPLATE
+inline uint32_t WS2812FX_T::blendPacked(uint32_t a, uint32_t b, uint8_t amount) {
+  uint32_t inv = 255U - amount;
+  uint32_t low  = (((a & 0x00FF00FF) * inv + (b & 0x00FF00FF) * amount) >> 8) & 0x00FF00FF;
+  uint32_t high =  (((a >> 8) & 0x00FF00FF) * inv + ((b >> 8) & 0x00FF00FF) * amount) & 0xFF00FF00;
+  return high | low;
+}
+
+/*
+ * Dirty span helpers. Anything that writes the pixel buffer directly (instead of
+ * going through setPixelColor()) must mark the pixels it changed, otherwise
+ * service() won't send them.
+ */
+WS2812FX_TEMPLATE
+void WS2812FX_T::setDirty(void) {
+  if(numLEDs > 0) setDirty(0, numLEDs - 1);
+}
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::setDirty(uint16_t first, uint16_t last) {
+  if(first < RENDER_STATE.dirty_start) RENDER_STATE.dirty_start = first;
+  if(last  > RENDER_STATE.dirty_stop)  RENDER_STATE.dirty_stop  = last;
+}
+
+WS2812FX_TEMPLATE
+boolean WS2812FX_T::isDirty(void) {
+  return RENDER_STATE.dirty_start <= RENDER_STATE.dirty_stop;
+}
+
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::getDirtyStart(void) {
+  return RENDER_STATE.dirty_start;
+}
+
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::getDirtyStop(void) {
+  return RENDER_STATE.dirty_stop;
+}
+
+// overload show() functions so we can use custom show()
+// with an asynchronous custom show(), a frame finished while the previous one is still
+// being sent is held back and sent by a later service() call, show() never blocks
+WS2812FX_TEMPLATE
+void WS2812FX_T::show(void) {
+  if(_frame != ledArray) writeOutput();
+
+  uint32_t hash = 0;
+  if(_suppress_duplicates) {
+    hash = frameHash();
+    if(_last_frame_valid && hash == _last_frame_hash) { // the LEDs already show this frame
+      _suppressed_frames++;
+      _show_pending = false;
+      RENDER_STATE.dirty_start = UINT16_MAX;
+      RENDER_STATE.dirty_stop = 0;
+      if(customShow == NULL && _num_outputs > 0) showOutputs(); // outputs held back by their refresh cap
+      return;
+    }
+  }
+
+  if(customShowBusy != NULL && customShowBusy()) {
+    _show_pending = true;
+    return;
+  }
+  _show_pending = false;
+
+  if(_front != ledArray) swapBuffers();
+
+  if(customShow != NULL) {
+    customShow();
+  } else if(_num_outputs > 0) {
+    showOutputs();
+  } else {
+    FastLED.show();
+    // Adafruit_NeoPixel::show();
+  }
+
+  if(_front != ledArray && isDirty()) { // the next frame is drawn on top of this one
+    uint16_t last = min(RENDER_STATE.dirty_stop, (uint16_t)(numLEDs - 1));
+    memcpy(ledArray + RENDER_STATE.dirty_start, _front + RENDER_STATE.dirty_start,
+      (last - RENDER_STATE.dirty_start + 1) * sizeof(ledArray[0]));
+  }
+  RENDER_STATE.dirty_start = UINT16_MAX; // everything has been sent
+  RENDER_STATE.dirty_stop = 0;
+
+  _last_frame_hash = hash;
+  _last_frame_valid = _suppress_duplicates;
+}
+
+/*
+ * Per output show scheduling. Only the outputs whose LEDs changed since the last
+ * show() (or that still have changes held back) are sent, an output whose refresh
+ * cap hasn't expired yet is sent by a later service() call instead.
+ */
+WS2812FX_TEMPLATE
+void WS2812FX_T::showOutputs(void) {
+  unsigned long now = millis();
+  uint8_t brightness = FastLED.getBrightness();
+  for(uint8_t i=0; i < _num_outputs; i++) {
+    output& o = _outputs[i];
+    if(!o.pending && (o.stop < RENDER_STATE.dirty_start || o.start > RENDER_STATE.dirty_stop)) continue; // unchanged
+
+    if(o.min_interval != 0 && now - o.last_show < o.min_interval) {
+      o.pending = true;
+      _show_pending = true;
+      continue;
+    }
+    o.controller->showLeds(brightness);
+    o.last_show = now;
+    o.pending = false;
+  }
+}
+
+// ms until the first output held back by its refresh cap can be sent, 0 if the
+// held back frame waits for an asynchronous custom show() instead
+WS2812FX_TEMPLATE
+unsigned long WS2812FX_T::timeToPendingShow(unsigned long now) {
+  unsigned long wait = ULONG_MAX;
+  if(customShow == NULL) {
+    for(uint8_t i=0; i < _num_outputs; i++) {
+      output& o = _outputs[i];
+      if(!o.pending) continue;
+      unsigned long elapsed = now - o.last_show;
+      unsigned long left = (elapsed >= o.min_interval) ? 0 : o.min_interval - elapsed;
+      if(left < wait) wait = left;
+    }
+  }
+  return (wait == ULONG_MAX) ? 0 : wait;
+}
+
+/*
+ * Control change queue. Web handlers, voice assistant callbacks or a serial
+ * parser running on another thread (or in an interrupt) than service() queue
+ * their changes instead of calling setSegment(), setMode(), ... in the middle
+ * of a frame. service() applies the queued changes, in order, before it
+ * renders the next frame. Returns false if COMMAND_QUEUE_SIZE changes are
+ * already waiting. With COMMAND_QUEUE_SIZE 0 there's no queue, the change is
+ * applied right away, so it has to come from the thread calling service().
+ */
+WS2812FX_TEMPLATE
+boolean WS2812FX_T::queueCommand(const command& c) {
+#if COMMAND_QUEUE_SIZE > 0
+  return _commands.push(c);
+#else
+  applyCommand(c);
+  _commands_applied = true; // service() shows it like a queued change
+  return true;
+#endif
+}
+
+WS2812FX_TEMPLATE
+boolean WS2812FX_T::queueSegment(uint8_t seg, uint16_t start, uint16_t stop, uint8_t mode, const uint32_t colors[], uint16_t speed, uint8_t options) {
+  command c = command();
+  c.type = CMD_SET_SEGMENT;
+  c.seg = seg;
+  c.start = start;
+  c.stop = stop;
+  c.speed = speed;
+  c.mode = mode;
+  c.options = options;
+  memcpy(c.colors, colors, sizeof(c.colors));
+  return queueCommand(c);
+}
+
+WS2812FX_TEMPLATE
+boolean WS2812FX_T::queueMode(uint8_t seg, uint8_t mode) {
+  command c = command();
+  c.type = CMD_SET_MODE;
+  c.seg = seg;
+  c.mode = mode;
+  return queueCommand(c);
+}
+
+WS2812FX_TEMPLATE
+boolean WS2812FX_T::queueColor(uint8_t seg, uint32_t color) {
+  command c = command();
+  c.type = CMD_SET_COLOR;
+  c.seg = seg;
+  c.colors[0] = color;
+  return queueCommand(c);
+}
+
+WS2812FX_TEMPLATE
+boolean WS2812FX_T::queueSpeed(uint8_t seg, uint16_t speed) {
+  command c = command();
+  c.type = CMD_SET_SPEED;
+  c.seg = seg;
+  c.speed = speed;
+  return queueCommand(c);
+}
+
+WS2812FX_TEMPLATE
+boolean WS2812FX_T::queueBrightness(uint8_t brightness) {
+  command c = command();
+  c.type = CMD_SET_BRIGHTNESS;
+  c.options = brightness;
+  return queueCommand(c);
+}
+
+// applies the queued changes, at most a queue's worth per call, so a busy producer can't stall the effects
+WS2812FX_TEMPLATE
+boolean WS2812FX_T::applyCommands(void) {
+#if COMMAND_QUEUE_SIZE > 0
+  command c;
+  uint16_t i = 0;
+  for(; i < COMMAND_QUEUE_SIZE && _commands.pop(c); i++) {
+    applyCommand(c);
+  }
+  return i > 0;
+#else
+  boolean applied = _commands_applied;
+  _commands_applied = false;
+  return applied;
+#endif
+}
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::applyCommand(const command& c) {
+  if(c.type <= CMD_SET_OPTIONS && c.seg >= MaxSegments) return; // bad segment index
+
+  switch(c.type) {
+    case CMD_SET_SEGMENT:
+      setSegment(c.seg, c.start, c.stop, c.mode, c.colors, c.speed, c.options);
+      break;
+    case CMD_SET_MODE:
+      setMode(c.seg, c.mode);
+      break;
+    case CMD_SET_COLOR:
+      setColor(c.seg, c.colors[0]);
+      break;
+    case CMD_SET_COLORS:
+      setColors(c.seg, (uint32_t*)c.colors);
+      break;
+    case CMD_SET_SPEED:
+      setSpeed(c.seg, c.speed);
+      break;
+    case CMD_SET_OPTIONS:
+      setOptions(c.seg, c.options);
+      break;
+    case CMD_SET_BRIGHTNESS:
+      applyBrightness(c.options);
+      break;
+    case CMD_START:
+      start();
+      break;
+    case CMD_STOP:
+      stop();
+      break;
+    case CMD_PAUSE:
+      pause();
+      break;
+    case CMD_RESUME:
+      resume();
+      break;
+    case CMD_TRIGGER:
+      trigger();
+      break;
+    case CMD_SET_SCENE:
+      if(_scene_slot.isQueued()) {
+        installScene(*_scene_slot.scene());
+        _scene_slot.release();
+      }
+      break;
+  }
+}
+
+/*
+ * Scenes. A scene holds a complete segment setup plus the brightness, so a
+ * scene change doesn't go through clear(), resetSegments(), setBrightness()
+ * and a setSegment() per segment, each of them visible on the strip (and
+ * setBrightness() sending an extra frame). setScene() checks the scene,
+ * copies it and queues it (see queueCommand()), so the caller can go on
+ * editing its own scene right away. service() installs the copy before it
+ * renders the next frame, which then shows the whole new scene. One scene
+ * waits at a time: returns false if the scene isn't valid, the previous one
+ * hasn't been installed yet (see isScenePending()), the command queue is
+ * full or there's no memory for the copy.
+ */
+WS2812FX_TEMPLATE
+boolean WS2812FX_T::setScene(const scene_config* s) {
+  if(!isValidScene(s)) return false;
+  scene_config* copy = _scene_slot.claim();
+  if(copy == NULL) return false;
+  *copy = *s;
+  _scene_slot.queued();
+  command c = command();
+  c.type = CMD_SET_SCENE;
+  if(!queueCommand(c)) {
+    _scene_slot.release();
+    return false;
+  }
+  return true;
+}
+
+// true while the scene passed to setScene() waits for service() to install it
+WS2812FX_TEMPLATE
+boolean WS2812FX_T::isScenePending(void) {
+  return !_scene_slot.isFree();
+}
+
+// true if every segment of the scene lies on the strip and runs an existing mode
+WS2812FX_TEMPLATE
+boolean WS2812FX_T::isValidScene(const scene_config* s) {
+  if(s == NULL || s->num_segments == 0 || s->num_segments > MaxSegments) return false;
+  for(uint8_t i=0; i < s->num_segments; i++) {
+    const segment& seg = s->segments[i];
+    if(seg.start > seg.stop || seg.stop >= numLEDs || seg.mode >= MODE_COUNT || seg.speed == 0) return false;
+  }
+  return true;
+}
+
+// the current setup as a scene, a starting point for a new one
+WS2812FX_TEMPLATE
+void WS2812FX_T::getScene(scene_config* s) {
+  s->num_segments = _num_segments;
+  s->brightness = getBrightness();
+  s->options = 0;
+  memcpy(s->segments, _segments, sizeof(_segments));
+}
+
+// the scene's segments start over, all of them are rendered by the same frame
+WS2812FX_TEMPLATE
+void WS2812FX_T::installScene(const scene_config& s) {
+  if(!isValidScene(&s)) return; // the strip got shorter since setScene()
+  memcpy(_segments, s.segments, s.num_segments * sizeof(segment));
+  _num_segments = s.num_segments;
+  resetSegmentRuntimes();
+  if(s.options & SCENE_CLEAR) {
+    for(uint16_t i=0; i < numLEDs; i++) {
+      _frame[i] = BLACK;
+    }
+    setDirty();
+  }
+  if(!(s.options & SCENE_KEEP_BRIGHTNESS)) applyBrightness(s.brightness);
+}
+
+/*
+ * Double buffering. By default the effects draw into the same LED array that
+ * FastLED.show() or an asynchronous custom show() is sending. With a double
+ * buffer, show() makes the frame just rendered the front buffer that is sent
+ * and the effects go on drawing into the other one, which gets the pixels that
+ * changed copied over, so effects that read pixels back (fade_out(),
+ * fireworks(), copyPixels(), ...) still start from the last frame. The second
+ * LED array (numBytes) is allocated on the heap, returns false if it can't be.
+ * getPixels() returns the buffer being drawn, getFrontBuffer() the one being
+ * sent, which is what a custom show() should send.
+ * Only the pixels marked with setDirty() are copied across, so code writing
+ * straight into getPixels() has to call setDirty() or the two buffers silently
+ * diverge. A copy of the instance gets a second LED array of its own (see
+ * WS2812FX_buffers).
+ */
+WS2812FX_TEMPLATE
+boolean WS2812FX_T::setDoubleBuffer(boolean enable) {
+  if(enable) {
+    if(_spare != NULL) return true;
+    _spare = (CRGB*)malloc(numBytes);
+    if(_spare == NULL) return false;
+    memcpy(_spare, ledArray, numBytes);
+    _front = ledArray; // the LEDs show the current LED array, draw into the spare one
+    ledArray = _spare;
+    if(_frame == _front) _frame = ledArray;
+    return true;
+  }
+
+  if(_spare == NULL) return true;
+  if(ledArray == _spare) { // go back to the array passed to the constructor
+    memcpy(_front, ledArray, numBytes);
+    ledArray = _front;
+    if(_frame == _spare) _frame = ledArray;
+  } else {
+    pointControllers(_front, ledArray);
+    _front = ledArray;
+  }
+  free(_spare);
+  _spare = NULL;
+  setDirty();
+  return true;
+}
+
+// makes the back buffer the one that is sent
+WS2812FX_TEMPLATE
+void WS2812FX_T::swapBuffers(void) {
+  CRGB* back = _front;
+  _front = ledArray;
+  ledArray = back;
+  if(_frame == _front) _frame = ledArray; // no linear buffer, the effects draw into the LED array
+  pointControllers(back, _front);
+}
+
+// moves the FastLED controllers (the outputs included) sending one LED array to the other
+WS2812FX_TEMPLATE
+void WS2812FX_T::pointControllers(struct CRGB* from, struct CRGB* to) {
+  for(int i=0; i < FastLED.count(); i++) {
+    CLEDController& c = FastLED[i];
+    if(c.leds() >= from && c.leds() < from + numLEDs) {
+      c.setLeds(to + (c.leds() - from), c.size());
+    }
+  }
+}
+
+// refresh cap of an output, at most 'fps' shows per second (0: no cap)
+WS2812FX_TEMPLATE
+void WS2812FX_T::setMaxRefreshRate(uint8_t output, uint8_t fps) {
+  if(output < _num_outputs) {
+    _outputs[output].min_interval = fps ? (1000 + fps - 1) / fps : 0;
+  }
+}
+
+WS2812FX_TEMPLATE
+uint8_t WS2812FX_T::getNumOutputs(void) {
+  return _num_outputs;
+}
+
+WS2812FX_TEMPLATE
+typename WS2812FX_T::Output* WS2812FX_T::getOutput(uint8_t output) {
+  return &_outputs[output];
+}
+
+#ifdef WS2812FX_THREADS
+/*
+ * Renders the segments due in a frame on n threads (the caller of service()
+ * included), 1 renders them one after another. The threads come from a pool
+ * shared by all instances, sized by the last call. Frames in which due segments
+ * overlap are rendered serially, otherwise every segment's mode must only
+ * write its own LEDs and must not change the segment setup.
+ */
+WS2812FX_TEMPLATE
+void WS2812FX_T::setRenderThreads(uint8_t n) {
+  _render_threads = max(n, (uint8_t)1);
+  WS2812FX_pool::instance().setThreads(_render_threads - 1);
+}
+
+WS2812FX_TEMPLATE
+uint8_t WS2812FX_T::getRenderThreads(void) {
+  return _render_threads;
+}
+#endif
+
+/*
+ * Duplicate frame suppression. When enabled, show() fingerprints the pixel
+ * buffer (plus the brightness) and doesn't send a frame that is identical to
+ * the last one sent. This also catches frames rendered through getPixels() or
+ * the CRGB array directly, at the cost of one pass over the buffer per show().
+ */
+WS2812FX_TEMPLATE
+void WS2812FX_T::setSuppressDuplicates(boolean enable) {
+  _suppress_duplicates = enable;
+  _last_frame_valid = false;
+}
+
+WS2812FX_TEMPLATE
+uint32_t WS2812FX_T::getSuppressedFrames(void) {
+  return _suppressed_frames;
+}
+
+// FNV-1a style hash of the pixel buffer, seeded with the brightness. Mixes
+// four bytes per multiply, with the remaining tail bytes mixed one at a time.
+WS2812FX_TEMPLATE
+uint32_t WS2812FX_T::frameHash(void) {
+  uint32_t hash = (2166136261UL ^ getBrightness()) * 16777619UL;
+  const uint8_t *pixels = (const uint8_t*)ledArray;
+  uint16_t i = 0;
+  for(; i + 4 <= numBytes; i += 4) {
+    uint32_t word;
+    memcpy(&word, pixels + i, sizeof(word));
+    hash = (hash ^ word) * 16777619UL;
+    hash ^= hash >> 15;
+  }
+  for(; i < numBytes; i++) {
+    hash = (hash ^ pixels[i]) * 16777619UL;
+  }
+  return hash;
+}
+
+/*
+ * Linear working buffer. By default effects render straight into the LED
+ * array, gamma corrected as each pixel is written, and FastLED scales the
+ * brightness while sending. That makes effects that read pixels back
+ * (fade_out(), fireworks(), ...) work on corrected values. With a linear
+ * buffer set, effects render linear colors into 'frame' (numLEDs entries) and
+ * show() converts the changed span into the LED array in a single pass, using
+ * a per-channel table that combines gamma, brightness and color order.
+ * Returns false if the tables can't be allocated. NULL goes back to rendering
+ * into the LED array.
+ */
+WS2812FX_TEMPLATE
+boolean WS2812FX_T::setLinearBuffer(struct CRGB* frame) {
+  if(frame == NULL || frame == ledArray) {
+    if(_frame != ledArray) {
+      FastLED.setBrightness(_brightness);
+      _output_lut.release();
+      _frame = ledArray;
+      setDirty();
+    }
+    return true;
+  }
+
+  if(_frame == ledArray) _brightness = FastLED.getBrightness();
+  if(!_output_lut.build(_brightness)) return false;
+  FastLED.setBrightness(BRIGHTNESS_MAX);
+  memcpy(frame, _frame, numBytes);
+  _frame = frame;
+  setDirty();
+  return true;
+}
+
+// order of the color channels in the LED array when a linear buffer is used.
+// FastLED's own controllers reorder the channels, so this is meant for custom shows.
+WS2812FX_TEMPLATE
+void WS2812FX_T::setColorOrder(EOrder order) {
+  for(uint8_t i=0; i < 3; i++) {
+    _color_order[i] = (order >> (3 * (2 - i))) & 7;
+  }
+  setDirty();
+}
+
+// converts the dirty span of the linear buffer into the LED array
+WS2812FX_TEMPLATE
+void WS2812FX_T::writeOutput(void) {
+  if(RENDER_STATE.dirty_start > RENDER_STATE.dirty_stop || !_output_lut.isBuilt()) return;
+  writeOutput(_output_lut[0], RENDER_STATE.dirty_start, RENDER_STATE.dirty_stop);
+
+  for(uint8_t i=0; i < _num_segments; i++) { // gamma corrected segments get a second pass
+    if((_segments[i].options & GAMMA) != GAMMA) continue;
+    uint16_t first = max(_segments[i].start, RENDER_STATE.dirty_start);
+    uint16_t last  = min(_segments[i].stop,  RENDER_STATE.dirty_stop);
+    if(first <= last) writeOutput(_output_lut[1], first, last);
+  }
+}
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::writeOutput(const uint8_t* lut, uint16_t first, uint16_t last) {
+  last = min(last, (uint16_t)(numLEDs - 1));
+  const uint8_t o0 = _color_order[0], o1 = _color_order[1], o2 = _color_order[2];
+  const CRGB* src = _frame + first;
+  CRGB* dest = ledArray + first;
+  for(uint16_t n = last - first + 1; n > 0; n--) {
+    const uint8_t* in = src->raw;
+    dest->raw[0] = lut[in[o0]];
+    dest->raw[1] = lut[in[o1]];
+    dest->raw[2] = lut[in[o2]];
+    src++;
+    dest++;
+  }
+}
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::start() {
+  resetSegmentRuntimes();
+  _running = true;
+}
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::stop() {
+  _running = false;
+  strip_off();
+}
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::pause() {
+  _running = false;
+}
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::resume() {
+  _running = true;
+}
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::trigger() {
+  _triggered = true;
+}
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::setMode(uint8_t m) {
+  setMode(0, m);
+}
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::setMode(uint8_t seg, uint8_t m) {
+  resetSegmentRuntime(seg);
+  _segments[seg].mode = constrain(m, 0, MODE_COUNT - 1);
+}
+
+// the palette that segment 'seg' samples instead of the color wheel, NULL for the color wheel
+WS2812FX_TEMPLATE
+void WS2812FX_T::setPalette(uint8_t seg, const palette16* p) {
+  _segments[seg].palette = p;
+}
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::setOptions(uint8_t seg, uint8_t o) {
+  if(_frame != ledArray && ((_segments[seg].options ^ o) & GAMMA)) {
+    setDirty(_segments[seg].start, _segments[seg].stop); // only the output stage changes
+  }
+  _segments[seg].options = o;
+}
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::setSpeed(uint16_t s) {
+  setSpeed(0, s);
+}
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::setSpeed(uint8_t seg, uint16_t s) {
+//  resetSegmentRuntime(seg);
+  _segments[seg].speed = constrain(s, SPEED_MIN, SPEED_MAX);
+}
+
+// frame rate target of a timed mode (MODE_TIMED) in segment 'seg', 0 for DEFAULT_FRAME_RATE
+WS2812FX_TEMPLATE
+void WS2812FX_T::setFrameRate(uint8_t seg, uint8_t fps) {
+  uint16_t interval = getFrameInterval(seg);
+  _segments[seg].frame_rate = fps;
+  if(getModeFlags(_segments[seg].mode) & MODE_TIMED) {
+    // keep the last frame time (next_time - interval) the elapsed time is measured from
+    _segment_runtimes[seg].next_time += getFrameInterval(seg) - interval;
+    _schedule_dirty = true;
+  }
+}
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::increaseSpeed(uint8_t s) {
+  uint16_t newSpeed = constrain(SEGMENT.speed + s, SPEED_MIN, SPEED_MAX);
+  setSpeed(newSpeed);
+}
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::decreaseSpeed(uint8_t s) {
+  uint16_t newSpeed = constrain(SEGMENT.speed - s, SPEED_MIN, SPEED_MAX);
+  setSpeed(newSpeed);
+}
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::setColor(uint8_t r, uint8_t g, uint8_t b) {
+  setColor(((uint32_t)g << 16) | ((uint32_t)r << 8) | b);
+}
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::setColor(uint8_t r, uint8_t g, uint8_t b, uint8_t w) {
+  setColor((((uint32_t)w << 24)| ((uint32_t)g << 16) | ((uint32_t)r << 8)| ((uint32_t)b)));
+}
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::setColor(uint32_t c) {
+  setColor(0, c);
+}
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::setColor(uint8_t seg, uint32_t c) {
+//  resetSegmentRuntime(seg);
+  _segments[seg].colors[0] = c;
+}
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::setColors(uint8_t seg, uint32_t* c) {
+//  resetSegmentRuntime(seg);
+  for(uint8_t i=0; i<NumColors; i++) {
+    _segments[seg].colors[i] = c[i];
+  }
+}
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::setBrightness(uint8_t b) {
+  applyBrightness(b);
+  show();
+}
+
+// sets the brightness the next show() sends with
+WS2812FX_TEMPLATE
+void WS2812FX_T::applyBrightness(uint8_t b) {
+  b = constrain(b, BRIGHTNESS_MIN, BRIGHTNESS_MAX);
+  _brightness = b;
+  if(_frame == ledArray) {
+    FastLED.setBrightness(b);
+  } else {
+    _output_lut.build(b); // the linear buffer has the brightness baked into the output
+  }
+  setDirty();
+}
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::increaseBrightness(uint8_t s) {
+  s = constrain(getBrightness() + s, BRIGHTNESS_MIN, BRIGHTNESS_MAX);
+  setBrightness(s);
+}
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::decreaseBrightness(uint8_t s) {
+  s = constrain(getBrightness() - s, BRIGHTNESS_MIN, BRIGHTNESS_MAX);
+  setBrightness(s);
+}
+
+// void WS2812FX::setLength(uint16_t b) {
+//   resetSegmentRuntimes();
+//   if (b < 1) b = 1;
+
+//   // Decrease numLEDs to maximum available memory
+//   do {
+//       Adafruit_NeoPixel::updateLength(b);
+//       b--;
+//   } while(!Adafruit_NeoPixel::numLEDs && b > 1);
+
+//   _segments[0].start = 0;
+//   _segments[0].stop = Adafruit_NeoPixel::numLEDs - 1;
+// }
+
+// void WS2812FX::increaseLength(uint16_t s) {
+//   s = _segments[0].stop - _segments[0].start + 1 + s;
+//   setLength(s);
+// }
+
+// void WS2812FX::decreaseLength(uint16_t s) {
+//   if (s > _segments[0].stop - _segments[0].start + 1) s = 1;
+//   s = _segments[0].stop - _segments[0].start + 1 - s;
+
+//   for(uint16_t i=_segments[0].start + s; i <= (_segments[0].stop - _segments[0].start + 1); i++) {
+//     setPixelColor(i, 0);
+//   }
+//   show();
+
+//   setLength(s);
+// }
+
+WS2812FX_TEMPLATE
+boolean WS2812FX_T::isRunning() {
+  return _running;
+}
+
+WS2812FX_TEMPLATE
+boolean WS2812FX_T::isTriggered() {
+  return _triggered;
+}
+
+// true while a frame is waiting for, or being sent by, an asynchronous custom show()
+WS2812FX_TEMPLATE
+boolean WS2812FX_T::isShowing() {
+  return _show_pending || (customShowBusy != NULL && customShowBusy());
+}
+
+WS2812FX_TEMPLATE
+boolean WS2812FX_T::isFrame() {
+  return isFrame(0);
+}
+
+WS2812FX_TEMPLATE
+boolean WS2812FX_T::isFrame(uint8_t segIndex) {
+  return (_segment_runtimes[segIndex].aux_param2 & FRAME);
+}
+
+WS2812FX_TEMPLATE
+boolean WS2812FX_T::isCycle() {
+  return isCycle(0);
+}
+
+WS2812FX_TEMPLATE
+boolean WS2812FX_T::isCycle(uint8_t segIndex) {
+  return (_segment_runtimes[segIndex].aux_param2 & CYCLE);
+}
+
+WS2812FX_TEMPLATE
+uint8_t WS2812FX_T::getMode(void) {
+  return getMode(0);
+}
+
+WS2812FX_TEMPLATE
+uint8_t WS2812FX_T::getMode(uint8_t seg) {
+  return _segments[seg].mode;
+}
+
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::getSpeed(void) {
+  return getSpeed(0);
+}
+
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::getSpeed(uint8_t seg) {
+  return _segments[seg].speed;
+}
+
+WS2812FX_TEMPLATE
+uint8_t WS2812FX_T::getFrameRate(uint8_t seg) {
+  return _segments[seg].frame_rate ? _segments[seg].frame_rate : DEFAULT_FRAME_RATE;
+}
+
+// ms between the frames of a timed mode
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::getFrameInterval(uint8_t seg) {
+  return max((uint16_t)(1000 / getFrameRate(seg)), SPEED_MIN);
+}
+
+
+WS2812FX_TEMPLATE
+uint8_t WS2812FX_T::getOptions(uint8_t seg) {
+  return _segments[seg].options;
+}
+
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::getLength(void) {
+  return numLEDs;
+}
+
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::getNumBytes(void) {
+  return numBytes;
+}
+
+/*
+ * Returns the number of milliseconds until the next segment is due, so the caller
+ * can sleep (delay(), ESP light sleep, timerfd/epoll on Linux...) instead of
+ * polling service() in a tight loop. Returns 0 if service() has work to do right
+ * now (including a held back frame waiting for an asynchronous show()), the time
+ * until an output held back by its refresh cap can be sent if that's sooner than
+ * the next segment, and ULONG_MAX if nothing is scheduled (the strip is stopped,
+ * paused or has no segments). Cap the sleep in that case, or changes made while
+ * the loop sleeps (a start() or a queued command) wait until it wakes up.
+ */
+WS2812FX_TEMPLATE
+unsigned long WS2812FX_T::getTimeToNextFrame(void) {
+  if(_triggered) return 0;
+  unsigned long now = millis();
+  unsigned long wait = ULONG_MAX;
+  if(_show_pending) {
+    wait = timeToPendingShow(now);
+    if(wait == 0) return 0;
+  }
+  if(!_running) return wait;
+  if(_schedule_dirty) rebuildSchedule();
+  if(_schedule_size == 0) return wait;
+
+  unsigned long next_time = _segment_runtimes[_schedule[0]].next_time;
+  if(now > next_time) return 0; // a segment is due once now > next_time
+  return (next_time - now + 1 < wait) ? next_time - now + 1 : wait;
+}
+
+WS2812FX_TEMPLATE
+uint8_t WS2812FX_T::getNumBytesPerPixel(void) {
+  return sizeof(CRGB);
+  // return (wOffset == rOffset) ? 3 : 4; // 3=RGB, 4=RGBW
+}
+
+// code that writes to the returned buffer has to mark its changes with setDirty()
+WS2812FX_TEMPLATE
+uint8_t* WS2812FX_T::getPixels(void) {
+  return (uint8_t*) _frame;
+}
+
+WS2812FX_TEMPLATE
+uint8_t* WS2812FX_T::getFrontBuffer(void) {
+  return (uint8_t*) _front;
+}
+
+WS2812FX_TEMPLATE
+uint8_t WS2812FX_T::getModeCount(void) {
+  return MODE_COUNT;
+}
+
+WS2812FX_TEMPLATE
+uint8_t WS2812FX_T::getModeFlags(uint8_t m) {
+  if(m < FX_MODE_CUSTOM_0) {
+    return pgm_read_byte(&_modes[m].flags);
+  } else if(m < MODE_COUNT) {
+    return MODE_CUSTOM | _custom_modes[m - FX_MODE_CUSTOM_0].flags;
+  }
+  return MODE_NO_FLAGS;
+}
+
+WS2812FX_TEMPLATE
+uint8_t WS2812FX_T::getNumSegments(void) {
+  return _num_segments;
+}
+
+// the segment currently being drawn (for custom effects)
+WS2812FX_TEMPLATE
+uint8_t WS2812FX_T::getSegmentIndex(void) {
+  return RENDER_STATE.segment_index;
+}
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::setNumSegments(uint8_t n) {
+  _num_segments = min(n, MaxSegments);
+  for(uint8_t i=_num_segments; i < MaxSegments; i++) releaseScratch(i);
+  _schedule_dirty = true;
+}
+
+WS2812FX_TEMPLATE
+uint8_t WS2812FX_T::getBrightness(void) {
+  return (_frame == ledArray) ? FastLED.getBrightness() : _brightness;
+}
+
+WS2812FX_TEMPLATE
+uint32_t WS2812FX_T::getPixelColor(uint16_t n) {
+  return _frame[n];
+}
+
+WS2812FX_TEMPLATE
+uint32_t WS2812FX_T::getColor(void) {
+  return getColor(0);
+}
+
+WS2812FX_TEMPLATE
+uint32_t WS2812FX_T::getColor(uint8_t seg) {
+  return _segments[seg].colors[0];
+}
+
+WS2812FX_TEMPLATE
+uint32_t* WS2812FX_T::getColors(uint8_t seg) {
+  return _segments[seg].colors;
+}
+
+WS2812FX_TEMPLATE
+typename WS2812FX_T::Segment* WS2812FX_T::getSegment(void) {
+  return &_segments[RENDER_STATE.segment_index];
+}
+
+WS2812FX_TEMPLATE
+typename WS2812FX_T::Segment* WS2812FX_T::getSegment(uint8_t seg) {
+  return &_segments[seg];
+}
+
+WS2812FX_TEMPLATE
+typename WS2812FX_T::Segment* WS2812FX_T::getSegments(void) {
+  return _segments;
+}
+
+WS2812FX_TEMPLATE
+typename WS2812FX_T::Segment_runtime* WS2812FX_T::getSegmentRuntime(void) {
+  return &_segment_runtimes[RENDER_STATE.segment_index];
+}
+
+WS2812FX_TEMPLATE
+typename WS2812FX_T::Segment_runtime* WS2812FX_T::getSegmentRuntime(uint8_t seg) {
+  return &_segment_runtimes[seg];
+}
+
+WS2812FX_TEMPLATE
+typename WS2812FX_T::Segment_runtime* WS2812FX_T::getSegmentRuntimes(void) {
+  return _segment_runtimes;
+}
+
+WS2812FX_TEMPLATE
+const __FlashStringHelper* WS2812FX_T::getModeName(uint8_t m) {
+  if(m < FX_MODE_CUSTOM_0) {
+    return FSH(pgm_read_ptr(&_modes[m].name));
+  } else if(m < MODE_COUNT) {
+    static const char* const custom_names[] PROGMEM = { name_56, name_57, name_58, name_59 };
+    uint8_t index = m - FX_MODE_CUSTOM_0;
+    if(_custom_modes[index].name != NULL) return _custom_modes[index].name;
+    return (index < 4) ? FSH(pgm_read_ptr(&custom_names[index])) : F("Custom"); // there are default names for the first four
+  } else {
+    return F("");
+  }
+}
+
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::setSegment(uint8_t n, uint16_t start, uint16_t stop, uint8_t mode, uint32_t color, uint16_t speed, bool reverse) {
+  uint32_t colors[NumColors] = {color};
+  setSegment(n, start, stop, mode, colors, speed, reverse);
+}
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::setSegment(uint8_t n, uint16_t start, uint16_t stop, uint8_t mode, uint32_t color, uint16_t speed, uint8_t options) {
+  uint32_t colors[NumColors] = {color};
+  setSegment(n, start, stop, mode, colors, speed, options);
+}
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::setSegment(uint8_t n, uint16_t start, uint16_t stop, uint8_t mode, const uint32_t colors[], uint16_t speed, bool reverse) {
+  setSegment(n, start, stop, mode, colors, speed, (uint8_t)(reverse ? REVERSE : NO_OPTIONS));
+}
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::setSegment(uint8_t n, uint16_t start, uint16_t stop, uint8_t mode, const uint32_t colors[], uint16_t speed, uint8_t options) {
+  if(n < (sizeof(_segments) / sizeof(_segments[0]))) {
+    if(n + 1 > _num_segments) _num_segments = n + 1;
+    _schedule_dirty = true;
+    if(_segments[n].mode != mode) releaseScratch(n); // the new mode starts with fresh state
+    _segments[n].start = start;
+    _segments[n].stop = stop;
+    _segments[n].mode = mode;
+    _segments[n].speed = speed;
+    _segments[n].options = options;
+
+    for(uint8_t i=0; i<NumColors; i++) {
+      _segments[n].colors[i] = colors[i];
+    }
+  }
+}
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::resetSegments() {
+  resetSegmentRuntimes();
+  memset(_segments, 0, sizeof(_segments));
+  RENDER_STATE.segment_index = 0;
+  _num_segments = 1;
+  setSegment(0, 0, 7, FX_MODE_STATIC, DEFAULT_COLOR, DEFAULT_SPEED, NO_OPTIONS);
+}
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::resetSegmentRuntimes() {
+  memset(_segment_runtimes, 0, sizeof(_segment_runtimes));
+  memset(_scratch_size, 0, sizeof(_scratch_size));
+  _scratch_used = 0;
+  _schedule_dirty = true;
+}
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::resetSegmentRuntime(uint8_t seg) {
+  memset(&_segment_runtimes[seg], 0, sizeof(_segment_runtimes[0]));
+  releaseScratch(seg);
+  _schedule_dirty = true;
+}
+
+/*
+ * Scratch memory for custom effects that need more state than the segment
+ * runtime's aux params. Returns a zeroed block of at least 'size' bytes for
+ * the current segment, the same block on every call until the segment's mode
+ * is changed or its runtime is reset. Returns NULL if the arena (ScratchSize)
+ * is full. Blocks move when other segments release theirs, so call this on
+ * every frame instead of keeping the pointer.
+ */
+WS2812FX_TEMPLATE
+void* WS2812FX_T::getScratch(uint16_t size) {
+#ifdef WS2812FX_THREADS
+  std::lock_guard<std::mutex> lock(WS2812FX_pool::instance().mutex());
+#endif
+  uint8_t seg = RENDER_STATE.segment_index;
+  size = (size + 7) & ~7; // keep every block 8 byte aligned
+  if(size > _scratch_size[seg]) {
+#ifdef WS2812FX_THREADS
+    if(&RENDER_STATE != &_render) { // a pool task, the other tasks' blocks must stay put until the join
+      if(size > ScratchSize - _scratch_used) return NULL;
+      if(_scratch_size[seg] > 0) _scratch_gaps = true;
+    } else
+#endif
+    releaseScratch(seg);
+    if(size > ScratchSize - _scratch_used) return NULL;
+    _scratch_offset[seg] = _scratch_used;
+    _scratch_size[seg] = size;
+    _scratch_used += size;
+    memset((uint8_t*)_scratch + _scratch_offset[seg], 0, size);
+  }
+  return (size > 0) ? (uint8_t*)_scratch + _scratch_offset[seg] : NULL;
+}
+
+#ifdef WS2812FX_THREADS
+// closes the gaps pool tasks left in the arena when they moved their blocks to its end
+WS2812FX_TEMPLATE
+void WS2812FX_T::compactScratch() {
+  uint8_t* arena = (uint8_t*)_scratch;
+  uint16_t used = 0;
+  while(true) { // move the blocks down in offset order
+    uint8_t next = MaxSegments;
+    for(uint8_t i=0; i < MaxSegments; i++) {
+      if(_scratch_size[i] > 0 && _scratch_offset[i] >= used &&
+        (next == MaxSegments || _scratch_offset[i] < _scratch_offset[next])) next = i;
+    }
+    if(next == MaxSegments) break;
+    memmove(arena + used, arena + _scratch_offset[next], _scratch_size[next]);
+    _scratch_offset[next] = used;
+    used += _scratch_size[next];
+  }
+  _scratch_used = used;
+  _scratch_gaps = false;
+}
+#endif
+
+// frees the segment's block and moves the blocks behind it down, so the free space stays in one piece
+WS2812FX_TEMPLATE
+void WS2812FX_T::releaseScratch(uint8_t seg) {
+  uint16_t size = _scratch_size[seg];
+  if(size == 0) return;
+
+  uint16_t offset = _scratch_offset[seg];
+  uint8_t* arena = (uint8_t*)_scratch;
+  memmove(arena + offset, arena + offset + size, _scratch_used - offset - size);
+  for(uint8_t i=0; i < MaxSegments; i++) {
+    if(_scratch_size[i] > 0 && _scratch_offset[i] > offset) _scratch_offset[i] -= size;
+  }
+  _scratch_used -= size;
+  _scratch_size[seg] = 0;
+}
+
+/*
+ * Segment scheduler helpers. _schedule[] is a binary min-heap of segment
+ * indexes, keyed by the segment's next_time.
+ */
+WS2812FX_TEMPLATE
+void WS2812FX_T::rebuildSchedule() {
+  _schedule_size = 0;
+  for(uint8_t i=0; i < _num_segments; i++) {
+    schedulePush(i);
+  }
+  _schedule_dirty = false;
+}
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::schedulePush(uint8_t seg) {
+  uint8_t pos = _schedule_size++;
+  while(pos > 0) {
+    uint8_t parent = (pos - 1) / 2;
+    if(_segment_runtimes[_schedule[parent]].next_time <= _segment_runtimes[seg].next_time) break;
+    _schedule[pos] = _schedule[parent];
+    pos = parent;
+  }
+  _schedule[pos] = seg;
+}
+
+WS2812FX_TEMPLATE
+uint8_t WS2812FX_T::schedulePop() {
+  uint8_t seg = _schedule[0];
+  _schedule[0] = _schedule[--_schedule_size];
+  scheduleSiftDown(0);
+  return seg;
+}
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::scheduleSiftDown(uint8_t pos) {
+  uint8_t seg = _schedule[pos];
+  unsigned long next_time = _segment_runtimes[seg].next_time;
+  while(true) {
+    uint16_t child = pos * 2 + 1;
+    if(child >= _schedule_size) break;
+    if(child + 1 < _schedule_size &&
+       _segment_runtimes[_schedule[child + 1]].next_time < _segment_runtimes[_schedule[child]].next_time) {
+      child++;
+    }
+    if(next_time <= _segment_runtimes[_schedule[child]].next_time) break;
+    _schedule[pos] = _schedule[child];
+    pos = child;
+  }
+  _schedule[pos] = seg;
+}
+
+/* #####################################################
+#
+#  Color and Blinken Functions
+#
+##################################################### */
+
+/*
+ * Turns everything off. Doh.
+ */
+WS2812FX_TEMPLATE
+void WS2812FX_T::strip_off() {
+  uint16_t length = getLength();
+  for (int i = 0; i < length; i++) {
+    // TODO: Change to crgb
+      _frame[i] = BLACK;
+  }
+  setDirty();
+  // Adafruit_NeoPixel::clear();
+  show();
+}
+
+
+/*
+ * Put a value 0 to 255 in to get a color value.
+ * The colours are a transition r -> g -> b -> back to r
+ * Inspired by the Adafruit examples.
+ */
+WS2812FX_TEMPLATE
+uint32_t WS2812FX_T::color_wheel(uint8_t pos) {
+  const uint8_t* rgb = _ColorWheelTable[pos];
+  return ((uint32_t)pgm_read_byte(rgb) << 16) | ((uint32_t)pgm_read_byte(rgb + 1) << 8) | pgm_read_byte(rgb + 2);
+}
+
+
+/*
+ * Samples a 16 color palette, 'pos' 0-255 goes around the palette once. Each
+ * entry covers 16 positions, blending into the next entry (the last one
+ * blends back into the first), so a palette reads like a smooth color wheel.
+ * Without a palette this is color_wheel().
+ */
+WS2812FX_TEMPLATE
+uint32_t WS2812FX_T::palette_color(uint8_t pos) {
+  return palette_color(SEGMENT.palette, pos);
+}
+
+WS2812FX_TEMPLATE
+uint32_t WS2812FX_T::palette_color(const palette16* p, uint8_t pos) {
+  if(p == NULL) return color_wheel(pos);
+
+  const uint8_t* c1 = p->colors[pos >> 4];
+  const uint8_t* c2 = p->colors[((pos >> 4) + 1) & 0x0F];
+  int16_t f = pos & 0x0F;
+  uint32_t color = 0;
+  for(uint8_t i=0; i < 3; i++) {
+    int16_t a = pgm_read_byte(c1 + i);
+    int16_t b = pgm_read_byte(c2 + i);
+    color = (color << 8) | (uint8_t)(a + (((b - a) * f) >> 4));
+  }
+  return color;
+}
+
+
+/*
+ * Returns a new, random wheel index with a minimum distance of 42 from pos.
+ */
+WS2812FX_TEMPLATE
+uint8_t WS2812FX_T::get_random_wheel_index(uint8_t pos) {
+  uint8_t r = 0;
+  uint8_t x = 0;
+  uint8_t y = 0;
+  uint8_t d = 0;
+
+  while(d < 42) {
+    r = random8();
+    x = abs(pos - r);
+    y = 255 - x;
+    d = min(x, y);
+  }
+
+  return r;
+}
+
+// fast 8-bit random number generator shamelessly borrowed from FastLED
+WS2812FX_TEMPLATE
+uint8_t WS2812FX_T::random8() {
+    RENDER_STATE.rand16seed = (RENDER_STATE.rand16seed * 2053) + 13849;
+    return (uint8_t)((RENDER_STATE.rand16seed + (RENDER_STATE.rand16seed >> 8)) & 0xFF);
+}
+
+// note random8(lim) generates numbers in the range 0 to (lim -1)
+WS2812FX_TEMPLATE
+uint8_t WS2812FX_T::random8(uint8_t lim) {
+    uint8_t r = random8();
+    r = (r * lim) >> 8;
+    return r;
+}
+
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::random16() {
+    return (uint16_t)random8() * 256 + random8();
+}
+
+// note random16(lim) generates numbers in the range 0 to (lim - 1)
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::random16(uint16_t lim) {
+    uint16_t r = random16();
+    r = ((uint32_t)r * lim) >> 16;
+    return r;
+}
+
+// Return the sum of all LED intensities (can be used for
+// rudimentary power calculations)
+WS2812FX_TEMPLATE
+uint32_t WS2812FX_T::intensitySum() {
+  uint8_t *pixels = (uint8_t*)ledArray;
+  uint32_t sum = 0;
+  for(uint16_t i=0; i <numBytes; i++) {
+    sum+= pixels[i];
+  }
+  return sum;
+}
+
+// Return the sum of each color's intensity. Note, the order of
+// intensities in the returned array depends on the type of WS2812
+// LEDs you have. NEO_GRB LEDs will return an array with entries
+// in a different order then NEO_RGB LEDs.
+WS2812FX_TEMPLATE
+uint32_t* WS2812FX_T::intensitySums() {
+  static uint32_t intensities[] = { 0, 0, 0, 0 };
+  memset(intensities, 0, sizeof(intensities));
+
+  uint8_t *pixels = (uint8_t*)ledArray;
+  uint8_t bytesPerPixel = getNumBytesPerPixel(); // 3=RGB, 4=RGBW
+  for(uint16_t i=0; i <numBytes; i += bytesPerPixel) {
+    intensities[0] += pixels[i];
+    intensities[1] += pixels[i + 1];
+    intensities[2] += pixels[i + 2];
+    if(bytesPerPixel == 4) intensities[3] += pixels[i + 3]; // for RGBW LEDs
+  }
+  return intensities;
+}
+
+/*
+ * No blinking. Just plain old static light.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_static(void) {
+  fill(RENDER_STATE.segment_index, SEGMENT.colors[0]);
+  return 500;
+}
+
+
+/*
+ * Blink/strobe function
+ * Alternate between color1 and color2
+ * if(strobe == true) then create a strobe effect
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::blink(uint32_t color1, uint32_t color2, bool strobe) {
+  uint32_t color = ((SEGMENT_RUNTIME.counter_mode_call & 1) == 0) ? color1 : color2;
+  if(IS_REVERSE) color = (color == color1) ? color2 : color1;
+  fill(RENDER_STATE.segment_index, color);
+
+  if((SEGMENT_RUNTIME.counter_mode_call & 1) == 0) {
+    return strobe ? 20 : (SEGMENT.speed / 2);
+  } else {
+    return strobe ? SEGMENT.speed - 20 : (SEGMENT.speed / 2);
+  }
+}
+
+
+/*
+ * Normal blinking. 50% on/off time.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_blink(void) {
+  return blink(SEGMENT.colors[0], SEGMENT.colors[1], false);
+}
+
+
+/*
+ * Classic Blink effect. Cycling through the rainbow.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_blink_rainbow(void) {
+  return blink(palette_color(SEGMENT_RUNTIME.counter_mode_call & 0xFF), SEGMENT.colors[1], false);
+}
+
+
+/*
+ * Classic Strobe effect.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_strobe(void) {
+  return blink(SEGMENT.colors[0], SEGMENT.colors[1], true);
+}
+
+
+/*
+ * Classic Strobe effect. Cycling through the rainbow.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_strobe_rainbow(void) {
+  return blink(palette_color(SEGMENT_RUNTIME.counter_mode_call & 0xFF), SEGMENT.colors[1], true);
+}
+
+
+/*
+ * Color wipe function
+ * LEDs are turned on (color1) in sequence, then turned off (color2) in sequence.
+ * if (bool rev == true) then LEDs are turned off in reverse order
+ * 'steps' is the number of steps per speed cycle (one on and one off pass is SEGMENT_LENGTH * 2)
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::color_wipe(uint32_t color1, uint32_t color2, bool rev, uint32_t steps) {
+  DISPATCH_KERNEL(color_wipe_kernel, color1, color2, rev, steps);
+}
+
+WS2812FX_TEMPLATE template<typename Opt>
+uint16_t WS2812FX_T::color_wipe_kernel(Opt o, uint32_t color1, uint32_t color2, bool rev, uint32_t steps) {
+  if(SEGMENT_RUNTIME.counter_mode_step < SEGMENT_LENGTH) {
+    uint32_t led_offset = SEGMENT_RUNTIME.counter_mode_step;
+    if(o.reverse()) {
+      putPixel(o, SEGMENT.stop - led_offset, color1);
+    } else {
+      putPixel(o, SEGMENT.start + led_offset, color1);
+    }
+  } else {
+    uint32_t led_offset = SEGMENT_RUNTIME.counter_mode_step - SEGMENT_LENGTH;
+    if(o.reverse() != rev) {
+      putPixel(o, SEGMENT.stop - led_offset, color2);
+    } else {
+      putPixel(o, SEGMENT.start + led_offset, color2);
+    }
+  }
+
+  if(SEGMENT_RUNTIME.counter_mode_step % SEGMENT_LENGTH == 0) SET_CYCLE;
+  else CLR_CYCLE;
+
+  SEGMENT_RUNTIME.counter_mode_step = (SEGMENT_RUNTIME.counter_mode_step + 1) % (SEGMENT_LENGTH * 2);
+  return stepDelay(steps);
+}
+
+/*
+ * Lights all LEDs one after another.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_color_wipe(void) {
+  return color_wipe(SEGMENT.colors[0], SEGMENT.colors[1], false, SEGMENT_LENGTH * 2);
+}
+
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_color_wipe_inv(void) {
+  return color_wipe(SEGMENT.colors[1], SEGMENT.colors[0], false, SEGMENT_LENGTH * 2);
+}
+
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_color_wipe_rev(void) {
+  return color_wipe(SEGMENT.colors[0], SEGMENT.colors[1], true, SEGMENT_LENGTH * 2);
+}
+
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_color_wipe_rev_inv(void) {
+  return color_wipe(SEGMENT.colors[1], SEGMENT.colors[0], true, SEGMENT_LENGTH * 2);
+}
+
+
+/*
+ * Turns all LEDs after each other to a random color.
+ * Then starts over with another color.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_color_wipe_random(void) {
+  if(SEGMENT_RUNTIME.counter_mode_step % SEGMENT_LENGTH == 0) { // aux_param will store our random color wheel index
+    SEGMENT_RUNTIME.aux_param = get_random_wheel_index(SEGMENT_RUNTIME.aux_param);
+  }
+  uint32_t color = palette_color(SEGMENT_RUNTIME.aux_param);
+  return color_wipe(color, color, false, SEGMENT_LENGTH); // one color per speed cycle
+}
+
+
+/*
+ * Random color introduced alternating from start and end of strip.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_color_sweep_random(void) {
+  if(SEGMENT_RUNTIME.counter_mode_step % SEGMENT_LENGTH == 0) { // aux_param will store our random color wheel index
+    SEGMENT_RUNTIME.aux_param = get_random_wheel_index(SEGMENT_RUNTIME.aux_param);
+  }
+  uint32_t color = palette_color(SEGMENT_RUNTIME.aux_param);
+  return color_wipe(color, color, true, SEGMENT_LENGTH);
+}
+
+
+/*
+ * Lights all LEDs in one random color up. Then switches them
+ * to the next random color.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_random_color(void) {
+  SEGMENT_RUNTIME.aux_param = get_random_wheel_index(SEGMENT_RUNTIME.aux_param); // aux_param will store our random color wheel index
+  uint32_t color = palette_color(SEGMENT_RUNTIME.aux_param);
+
+  for(uint16_t i=SEGMENT.start; i <= SEGMENT.stop; i++) {
+    setPixelColor(i, color);
+  }
+  return (SEGMENT.speed);
+}
+
+
+/*
+ * Lights every LED in a random color. Changes one random LED after the other
+ * to another random color.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_single_dynamic(void) {
+  if(SEGMENT_RUNTIME.counter_mode_call == 0) {
+    for(uint16_t i=SEGMENT.start; i <= SEGMENT.stop; i++) {
+      setPixelColor(i, palette_color(random8()));
+    }
+  }
+
+  setPixelColor(SEGMENT.start + random16(SEGMENT_LENGTH), palette_color(random8()));
+  return (SEGMENT.speed);
+}
+
+
+/*
+ * Lights every LED in a random color. Changes all LED at the same time
+ * to new random colors.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_multi_dynamic(void) {
+  uint32_t colors[16];
+  for(uint16_t i=0; i < SEGMENT_LENGTH; i += 16) {
+    uint8_t count = min(16, SEGMENT_LENGTH - i);
+    for(uint8_t j=0; j < count; j++) {
+      colors[j] = palette_color(random8());
+    }
+    writeSpan(RENDER_STATE.segment_index, i, colors, count);
+  }
+  return (SEGMENT.speed);
+}
+
+
+/*
+ * Does the "standby-breathing" of well known i-Devices. Fixed Speed.
+ * Use mode "fade" if you like to have something similar with a different speed.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_breath(void) {
+  int lum = SEGMENT_RUNTIME.counter_mode_step;
+  if(lum > 255) lum = 511 - lum; // lum = 15 -> 255 -> 15
+
+  uint16_t delay;
+  if(lum == 15) delay = 970; // 970 pause before each breath
+  else if(lum <=  25) delay = 38; // 19
+  else if(lum <=  50) delay = 36; // 18
+  else if(lum <=  75) delay = 28; // 14
+  else if(lum <= 100) delay = 20; // 10
+  else if(lum <= 125) delay = 14; // 7
+  else if(lum <= 150) delay = 11; // 5
+  else delay = 10; // 4
+
+  uint32_t color = SEGMENT.colors[0];
+  uint8_t w = (color >> 24 & 0xFF) * lum / 256;
+  uint8_t g = (color >> 16 & 0xFF) * lum / 256;
+  uint8_t r = (color >>  8 & 0xFF) * lum / 256;
+  uint8_t b = (color       & 0xFF) * lum / 256;
+  for(uint16_t i=SEGMENT.start; i <= SEGMENT.stop; i++) {
+    setPixelColor(i, r, g, b, w);
+  }
+
+  SEGMENT_RUNTIME.counter_mode_step += 2;
+  if(SEGMENT_RUNTIME.counter_mode_step > (512-15)) SEGMENT_RUNTIME.counter_mode_step = 15;
+  return delay;
+}
+
+
+/*
+ * Fades the LEDs between two colors
+ */
+WS2812FX_TEMPLATE
+void WS2812FX_T::mode_fade(uint16_t /* elapsed */, uint16_t phase) {
+  int lum = phase >> 7;
+  if(lum > 255) lum = 511 - lum; // lum = 0 -> 255 -> 0
+
+  uint32_t color = color_blend(SEGMENT.colors[0], SEGMENT.colors[1], lum);
+  fill(RENDER_STATE.segment_index, color);
+}
+
+
+/*
+ * scan function - runs a block of pixels back and forth.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::scan(uint32_t color1, uint32_t color2, bool dual) {
+  DISPATCH_KERNEL(scan_kernel, color1, color2, dual);
+}
+
+WS2812FX_TEMPLATE template<typename Opt>
+uint16_t WS2812FX_T::scan_kernel(Opt o, uint32_t color1, uint32_t color2, bool dual) {
+  int8_t dir = SEGMENT_RUNTIME.aux_param ? -1 : 1;
+  uint8_t size = 1 << o.size();
+
+  if(!RENDER_STATE.catch_up) {
+    fill(RENDER_STATE.segment_index, color2);
+
+    for(uint8_t i = 0; i < size; i++) {
+      if(o.reverse() || dual) {
+        putPixel(o, SEGMENT.stop - SEGMENT_RUNTIME.counter_mode_step - i, color1);
+      }
+      if(!o.reverse() || dual) {
+        putPixel(o, SEGMENT.start + SEGMENT_RUNTIME.counter_mode_step + i, color1);
+      }
+    }
+  }
+
+  SEGMENT_RUNTIME.counter_mode_step += dir;
+  if(SEGMENT_RUNTIME.counter_mode_step == 0) SEGMENT_RUNTIME.aux_param = 0;
+  if(SEGMENT_RUNTIME.counter_mode_step >= (uint16_t)(SEGMENT_LENGTH - size)) SEGMENT_RUNTIME.aux_param = 1;
+
+  return stepDelay(SEGMENT_LENGTH * 2);
+}
+
+
+/*
+ * Runs a block of pixels back and forth.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_scan(void) {
+  return scan(SEGMENT.colors[0], SEGMENT.colors[1], false);
+}
+
+
+/*
+ * Runs two blocks of pixels back and forth in opposite directions.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_dual_scan(void) {
+  return scan(SEGMENT.colors[0], SEGMENT.colors[1], true);
+}
+
+
+/*
+ * Cycles all LEDs at once through a rainbow.
+ */
+WS2812FX_TEMPLATE
+void WS2812FX_T::mode_rainbow(uint16_t /* elapsed */, uint16_t phase) {
+  uint32_t color = palette_color(phase >> 8);
+  for(uint16_t i=SEGMENT.start; i <= SEGMENT.stop; i++) {
+    setPixelColor(i, color);
+  }
+}
+
+
+/*
+ * Cycles a rainbow over the entire string of LEDs.
+ */
+WS2812FX_TEMPLATE
+void WS2812FX_T::mode_rainbow_cycle(uint16_t /* elapsed */, uint16_t phase) {
+  // pixel i gets hue i * 256 / SEGMENT_LENGTH, in 8.8 fixed point the step is 65536 / SEGMENT_LENGTH
+  uint32_t turn = 65536UL;
+  hueRamp(RENDER_STATE.segment_index, phase, turn / SEGMENT_LENGTH, turn % SEGMENT_LENGTH, SEGMENT_LENGTH);
+}
+
+
+/*
+ * Theatre-style crawling lights.
+ * Inspired by the Adafruit examples.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_theater_chase(void) {
+  return tricolor_chase(SEGMENT.colors[0], SEGMENT.colors[1], SEGMENT.colors[1]);
+}
+
+
+/*
+ * Theatre-style crawling lights with rainbow effect.
+ * Inspired by the Adafruit examples.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_theater_chase_rainbow(void) {
+  SEGMENT_RUNTIME.counter_mode_step = (SEGMENT_RUNTIME.counter_mode_step + 1) & 0xFF;
+  uint32_t color = palette_color(SEGMENT_RUNTIME.counter_mode_step);
+  return tricolor_chase(color, SEGMENT.colors[1], SEGMENT.colors[1]);
+}
+
+
+/*
+ * Running lights effect with smooth sine transition.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_running_lights(void) {
+  return running_lights(SEGMENT.colors[0]);
+}
+
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::running_lights(uint32_t color) {
+  DISPATCH_KERNEL(running_lights_kernel, color);
+}
+
+WS2812FX_TEMPLATE template<typename Opt>
+uint16_t WS2812FX_T::running_lights_kernel(Opt o, uint32_t color) {
+  uint8_t g = ((color >> 16) & 0xFF);
+  uint8_t r = ((color >>  8) & 0xFF);
+  uint8_t b =  (color        & 0xFF);
+
+  uint16_t start = SEGMENT.start, stop = SEGMENT.stop, length = SEGMENT_LENGTH;
+  uint32_t step = SEGMENT_RUNTIME.counter_mode_step;
+  uint8_t size = 1 << o.size();
+  uint8_t sineIncr = max(1, (256 / length) * size);
+  for(uint16_t i=0; i < length && !RENDER_STATE.catch_up; i++) {
+    int lum = (int)sin8(((i + step) * sineIncr));
+    putPixel(o, o.reverse() ? start + i : stop - i, (r * lum) / 256, (g * lum) / 256, (b * lum) / 256);
+  }
+  SEGMENT_RUNTIME.counter_mode_step = (step + 1) % 256;
+  return stepDelay(length);
+}
+
+
+/*
+ * twinkle function
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::twinkle(uint32_t color1, uint32_t color2) {
+  if(SEGMENT_RUNTIME.counter_mode_step == 0) {
+    for(uint16_t i=SEGMENT.start; i <= SEGMENT.stop; i++) {
+      setPixelColor(i, color2);
+    }
+    uint16_t min_leds = max(1, SEGMENT_LENGTH / 5); // make sure, at least one LED is on
+    uint16_t max_leds = max(1, SEGMENT_LENGTH / 2); // make sure, at least one LED is on
+    SEGMENT_RUNTIME.counter_mode_step = random(min_leds, max_leds);
+  }
+
+  setPixelColor(SEGMENT.start + random16(SEGMENT_LENGTH), color1);
+
+  SEGMENT_RUNTIME.counter_mode_step--;
+  return (SEGMENT.speed / SEGMENT_LENGTH);
+}
+
+/*
+ * Blink several LEDs on, reset, repeat.
+ * Inspired by www.tweaking4all.com/hardware/arduino/arduino-led-strip-effects/
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_twinkle(void) {
+  return twinkle(SEGMENT.colors[0], SEGMENT.colors[1]);
+}
+
+/*
+ * Blink several LEDs in random colors on, reset, repeat.
+ * Inspired by www.tweaking4all.com/hardware/arduino/arduino-led-strip-effects/
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_twinkle_random(void) {
+  return twinkle(palette_color(random8()), SEGMENT.colors[1]);
+}
+
+
+/*
+ * fade out functions
+ */
+WS2812FX_TEMPLATE
+void WS2812FX_T::fade_out() {
+  return fade_out(SEGMENT.colors[1]);
+}
+
+WS2812FX_TEMPLATE
+void WS2812FX_T::fade_out(uint32_t targetColor) {
+  static const uint8_t rateMapH[] = {0, 1, 1, 1, 2, 3, 4, 6};
+  static const uint8_t rateMapL[] = {0, 2, 3, 8, 8, 8, 8, 8};
+
+  uint8_t rate  = FADE_RATE;
+  uint8_t rateH = rateMapH[rate];
+  uint8_t rateL = rateMapL[rate];
+
+  // colors are packed 0xGGRRBB but the CRGB array reads back as 0xRRGGBB, so the
+  // fade has always moved a pixel's green into red and its red into green. The
+  // targets are listed in output order, each output channel fades the input
+  // channel in src[].
+  const uint8_t target[3] = {(uint8_t)(targetColor >> 8), (uint8_t)(targetColor >> 16), (uint8_t)targetColor};
+  const uint8_t src[3] = {1, 0, 2};
+  boolean gamma = IS_GAMMA && _frame == ledArray;
+
+  uint16_t start = SEGMENT.start;
+  uint16_t count = SEGMENT_LENGTH;
+  CRGB* leds = _frame + start;
+#ifdef WS2812FX_STATS
+  RENDER_STATE.pixel_writes += count;
+#endif
+
+  int32_t first = -1, last = -1;
+  if(count >= FADE_LUT_MIN_LENGTH) {
+    // every pixel fades towards the same color, so each output channel only depends
+    // on one input byte. Tabulate the fade once and the segment is three lookups per pixel.
+    uint8_t lut[3][256];
+    for(uint8_t k=0; k < 3; k++) {
+      for(uint16_t v=0; v < 256; v++) {
+        uint8_t c = fadeChannel(v, target[k], rate, rateH, rateL);
+        lut[k][v] = gamma ? gamma8(c) : c;
+      }
+    }
+    for(uint16_t i=0; i < count; i++) {
+      CRGB pixel(lut[0][leds[i].raw[src[0]]], lut[1][leds[i].raw[src[1]]], lut[2][leds[i].raw[src[2]]]);
+      if(!samePixel(leds[i], pixel)) {
+        leds[i] = pixel;
+        if(first < 0) first = i;
+        last = i;
+      }
+    }
+  } else {
+    for(uint16_t i=0; i < count; i++) {
+      CRGB pixel(
+        fadeChannel(leds[i].raw[src[0]], target[0], rate, rateH, rateL),
+        fadeChannel(leds[i].raw[src[1]], target[1], rate, rateH, rateL),
+        fadeChannel(leds[i].raw[src[2]], target[2], rate, rateH, rateL));
+      if(gamma) pixel.setRGB(gamma8(pixel.r), gamma8(pixel.g), gamma8(pixel.b));
+      if(!samePixel(leds[i], pixel)) {
+        leds[i] = pixel;
+        if(first < 0) first = i;
+        last = i;
+      }
+    }
+  }
+  if(first >= 0) setDirty(start + first, start + last);
+}
+
+WS2812FX_TEMPLATE
+inline uint8_t WS2812FX_T::fadeChannel(uint8_t c, uint8_t target, uint8_t rate, uint8_t rateH, uint8_t rateL) {
+  if(rate == 0) return c >> 1; // old fade-to-black algorithm
+
+  // new fade-to-color algorithm
+  // if the current and target colors are almost the same, jump right to the target
+  // color, otherwise calculate an intermediate color. (fixes rounding issues)
+  int delta = target - c;
+  int step = (delta >> rateH) + (delta >> rateL);
+  return c + ((unsigned)(delta + 2) <= 4 ? delta : step); // abs(delta) < 3, without a branch
+}
+
+
+/*
+ * color blend function
+ */
+WS2812FX_TEMPLATE
+uint32_t WS2812FX_T::color_blend(uint32_t color1, uint32_t color2, uint8_t blend) {
+  if(blend == 0)   return color1;
+  if(blend == 255) return color2;
+
+  return blendPacked(color1, color2, blend);
+}
+
+
+/*
+ * twinkle_fade function
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::twinkle_fade(uint32_t color) {
+  fade_out();
+
+  if(random8(3) == 0) {
+    uint8_t size = 1 << SIZE_OPTION;
+    uint16_t index = SEGMENT.start + random16(SEGMENT_LENGTH - size);
+    for(uint8_t i=0; i<size; i++) {
+      setPixelColor(index + i, color);
+    }
+  }
+  return (SEGMENT.speed / 8);
+}
+
+
+/*
+ * Blink several LEDs on, fading out.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_twinkle_fade(void) {
+  return twinkle_fade(SEGMENT.colors[0]);
+}
+
+
+/*
+ * Blink several LEDs in random colors on, fading out.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_twinkle_fade_random(void) {
+  return twinkle_fade(palette_color(random8()));
+}
+
+
+/*
+ * Blinks one LED at a time.
+ * Inspired by www.tweaking4all.com/hardware/arduino/arduino-led-strip-effects/
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_sparkle(void) {
+  uint8_t size = 1 << SIZE_OPTION;
+  for(uint8_t i=0; i<size; i++) {
+    setPixelColor(SEGMENT.start + SEGMENT_RUNTIME.aux_param3 + i, SEGMENT.colors[1]);
+  }
+  SEGMENT_RUNTIME.aux_param3 = random16(SEGMENT_LENGTH - size); // aux_param3 stores the random led index
+  for(uint8_t i=0; i<size; i++) {
+    setPixelColor(SEGMENT.start + SEGMENT_RUNTIME.aux_param3 + i, SEGMENT.colors[0]);
+  }
+  return (SEGMENT.speed / SEGMENT_LENGTH);
+}
+
+
+/*
+ * Lights all LEDs in the color. Flashes white pixels randomly.
+ * Inspired by www.tweaking4all.com/hardware/arduino/arduino-led-strip-effects/
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_flash_sparkle(void) {
+  for(uint16_t i=SEGMENT.start; i <= SEGMENT.stop; i++) {
+    setPixelColor(i, SEGMENT.colors[0]);
+  }
+
+  if(random8(5) == 0) {
+    uint8_t size = 1 << SIZE_OPTION;
+    uint16_t index = SEGMENT.start + random16(SEGMENT_LENGTH - size);
+    for(uint8_t j=0; j<size; j++) {
+      setPixelColor(index + j, WHITE);
+    }
+    return 20;
+  }
+
+  return SEGMENT.speed;
+}
+
+
+/*
+ * Like flash sparkle. With more flash.
+ * Inspired by www.tweaking4all.com/hardware/arduino/arduino-led-strip-effects/
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_hyper_sparkle(void) {
+  for(uint16_t i=SEGMENT.start; i <= SEGMENT.stop; i++) {
+    setPixelColor(i, SEGMENT.colors[0]);
+  }
+
+  if(random8(5) < 2) {
+    for(uint16_t i=0; i < max(1, SEGMENT_LENGTH/3); i++) {
+      setPixelColor(SEGMENT.start + random16(SEGMENT_LENGTH), WHITE);
+    }
+    return 20;
+  }
+  return SEGMENT.speed;
+}
+
+
+/*
+ * Strobe effect with different strobe count and pause, controlled by speed.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_multi_strobe(void) {
+  for(uint16_t i=SEGMENT.start; i <= SEGMENT.stop; i++) {
+    setPixelColor(i, BLACK);
+  }
+
+  uint16_t delay = 200 + ((9 - (SEGMENT.speed % 10)) * 100);
+  uint16_t count = 2 * ((SEGMENT.speed / 100) + 1);
+  if(SEGMENT_RUNTIME.counter_mode_step < count) {
+    if((SEGMENT_RUNTIME.counter_mode_step & 1) == 0) {
+      for(uint16_t i=SEGMENT.start; i <= SEGMENT.stop; i++) {
+        setPixelColor(i, SEGMENT.colors[0]);
+      }
+      delay = 20;
+    } else {
+      delay = 50;
+    }
+  }
+  SEGMENT_RUNTIME.counter_mode_step = (SEGMENT_RUNTIME.counter_mode_step + 1) % (count + 1);
+  return delay;
+}
+
+
+// setPixelColor() with the options known
+WS2812FX_TEMPLATE template<typename Opt>
+inline void WS2812FX_T::putPixel(Opt o, uint16_t n, uint8_t r, uint8_t g, uint8_t b) {
+#ifdef WS2812FX_STATS
+  RENDER_STATE.pixel_writes++;
+#endif
+  if(o.gamma()) {
+    writePixel(n, gamma8(r), gamma8(g), gamma8(b));
+  } else {
+    writePixel(n, r, g, b);
+  }
+}
+
+WS2812FX_TEMPLATE template<typename Opt>
+inline void WS2812FX_T::putPixel(Opt o, uint16_t n, uint32_t c) {
+  putPixel(o, n, (uint8_t)(c >> 8), (uint8_t)(c >> 16), (uint8_t)c);
+}
+
+
+/*
+ * color chase function.
+ * color1 = background color
+ * color2 and color3 = colors of two adjacent leds
+ */
+
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::chase(uint32_t color1, uint32_t color2, uint32_t color3) {
+  DISPATCH_KERNEL(chase_kernel, color1, color2, color3);
+}
+
+WS2812FX_TEMPLATE template<typename Opt>
+uint16_t WS2812FX_T::chase_kernel(Opt o, uint32_t color1, uint32_t color2, uint32_t color3) {
+  uint16_t start = SEGMENT.start, stop = SEGMENT.stop, length = SEGMENT_LENGTH;
+  uint8_t size = 1 << o.size();
+  for(uint8_t i=0; i<size; i++) {
+    uint16_t a = (SEGMENT_RUNTIME.counter_mode_step + i) % length;
+    uint16_t b = (a + size) % length;
+    uint16_t c = (b + size) % length;
+    if(o.reverse()) {
+      putPixel(o, stop - a, color1);
+      putPixel(o, stop - b, color2);
+      putPixel(o, stop - c, color3);
+    } else {
+      putPixel(o, start + a, color1);
+      putPixel(o, start + b, color2);
+      putPixel(o, start + c, color3);
+    }
+  }
+
+  if(SEGMENT_RUNTIME.counter_mode_step + (size * 3) == length) SET_CYCLE;
+  else CLR_CYCLE;
+
+  SEGMENT_RUNTIME.counter_mode_step = (SEGMENT_RUNTIME.counter_mode_step + 1) % length;
+  return stepDelay(length);
+}
+
+
+/*
+ * Bicolor chase mode
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_bicolor_chase(void) {
+  return chase(SEGMENT.colors[0], SEGMENT.colors[1], SEGMENT.colors[2]);
+}
+
+
+/*
+ * White running on _color.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_chase_color(void) {
+  return chase(SEGMENT.colors[0], WHITE, WHITE);
+}
+
+
+/*
+ * Black running on _color.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_chase_blackout(void) {
+  return chase(SEGMENT.colors[0], BLACK, BLACK);
+}
+
+
+/*
+ * _color running on white.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_chase_white(void) {
+  return chase(WHITE, SEGMENT.colors[0], SEGMENT.colors[0]);
+}
+
+
+/*
+ * White running followed by random color.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_chase_random(void) {
+  if(SEGMENT_RUNTIME.counter_mode_step == 0) {
+    SEGMENT_RUNTIME.aux_param = get_random_wheel_index(SEGMENT_RUNTIME.aux_param);
+  }
+  return chase(palette_color(SEGMENT_RUNTIME.aux_param), WHITE, WHITE);
+}
+
+
+/*
+ * Rainbow running on white.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_chase_rainbow_white(void) {
+  uint16_t n = SEGMENT_RUNTIME.counter_mode_step;
+  uint16_t m = (SEGMENT_RUNTIME.counter_mode_step + 1) % SEGMENT_LENGTH;
+  uint32_t color2 = palette_color(((n * 256 / SEGMENT_LENGTH) + (SEGMENT_RUNTIME.counter_mode_call & 0xFF)) & 0xFF);
+  uint32_t color3 = palette_color(((m * 256 / SEGMENT_LENGTH) + (SEGMENT_RUNTIME.counter_mode_call & 0xFF)) & 0xFF);
+
+  return chase(WHITE, color2, color3);
+}
+
+
+/*
+ * White running on rainbow.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_chase_rainbow(void) {
+  uint8_t color_sep = 256 / SEGMENT_LENGTH;
+  uint8_t color_index = SEGMENT_RUNTIME.counter_mode_call & 0xFF;
+  uint32_t color = palette_color(((SEGMENT_RUNTIME.counter_mode_step * color_sep) + color_index) & 0xFF);
+
+  return chase(color, WHITE, WHITE);
+}
+
+
+/*
+ * Black running on rainbow.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_chase_blackout_rainbow(void) {
+  uint8_t color_sep = 256 / SEGMENT_LENGTH;
+  uint8_t color_index = SEGMENT_RUNTIME.counter_mode_call & 0xFF;
+  uint32_t color = palette_color(((SEGMENT_RUNTIME.counter_mode_step * color_sep) + color_index) & 0xFF);
+
+  return chase(color, BLACK, BLACK);
+}
+
+
+/*
+ * White flashes running on _color.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_chase_flash(void) {
+  const static uint8_t flash_count = 4;
+  uint8_t flash_step = SEGMENT_RUNTIME.counter_mode_call % ((flash_count * 2) + 1);
+
+  for(uint16_t i=SEGMENT.start; i <= SEGMENT.stop; i++) {
+    setPixelColor(i, SEGMENT.colors[0]);
+  }
+
+  uint16_t delay = (SEGMENT.speed / SEGMENT_LENGTH);
+  if(flash_step < (flash_count * 2)) {
+    if(flash_step % 2 == 0) {
+      uint16_t n = SEGMENT_RUNTIME.counter_mode_step;
+      uint16_t m = (SEGMENT_RUNTIME.counter_mode_step + 1) % SEGMENT_LENGTH;
+      if(IS_REVERSE) {
+        setPixelColor(SEGMENT.stop - n, WHITE);
+        setPixelColor(SEGMENT.stop - m, WHITE);
+      } else {
+        setPixelColor(SEGMENT.start + n, WHITE);
+        setPixelColor(SEGMENT.start + m, WHITE);
+      }
+      delay = 20;
+    } else {
+      delay = 30;
+    }
+  } else {
+    SEGMENT_RUNTIME.counter_mode_step = (SEGMENT_RUNTIME.counter_mode_step + 1) % SEGMENT_LENGTH;
+  }
+  return delay;
+}
+
+
+/*
+ * White flashes running, followed by random color.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_chase_flash_random(void) {
+  const static uint8_t flash_count = 4;
+  uint8_t flash_step = SEGMENT_RUNTIME.counter_mode_call % ((flash_count * 2) + 1);
+
+  for(uint16_t i=0; i < SEGMENT_RUNTIME.counter_mode_step; i++) {
+    setPixelColor(SEGMENT.start + i, palette_color(SEGMENT_RUNTIME.aux_param));
+  }
+
+  uint16_t delay = (SEGMENT.speed / SEGMENT_LENGTH);
+  if(flash_step < (flash_count * 2)) {
+    uint16_t n = SEGMENT_RUNTIME.counter_mode_step;
+    uint16_t m = (SEGMENT_RUNTIME.counter_mode_step + 1) % SEGMENT_LENGTH;
+    if(flash_step % 2 == 0) {
+      setPixelColor(SEGMENT.start + n, WHITE);
+      setPixelColor(SEGMENT.start + m, WHITE);
+      delay = 20;
+    } else {
+      setPixelColor(SEGMENT.start + n, palette_color(SEGMENT_RUNTIME.aux_param));
+      setPixelColor(SEGMENT.start + m, BLACK);
+      delay = 30;
+    }
+  } else {
+    SEGMENT_RUNTIME.counter_mode_step = (SEGMENT_RUNTIME.counter_mode_step + 1) % SEGMENT_LENGTH;
+
+    if(SEGMENT_RUNTIME.counter_mode_step == 0) {
+      SEGMENT_RUNTIME.aux_param = get_random_wheel_index(SEGMENT_RUNTIME.aux_param);
+    }
+  }
+  return delay;
+}
+
+
+/*
+ * Alternating pixels running function.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::running(uint32_t color1, uint32_t color2) {
+  DISPATCH_KERNEL(running_kernel, color1, color2);
+}
+
+WS2812FX_TEMPLATE template<typename Opt>
+uint16_t WS2812FX_T::running_kernel(Opt o, uint32_t color1, uint32_t color2) {
+  uint16_t start = SEGMENT.start, stop = SEGMENT.stop, length = SEGMENT_LENGTH;
+  uint32_t step = SEGMENT_RUNTIME.counter_mode_step;
+  uint8_t size = 4 << o.size();
+  for(uint16_t i=0; i < length && !RENDER_STATE.catch_up; i++) {
+    uint16_t n = o.reverse() ? start + i : stop - i;
+    putPixel(o, n, ((i + step) % size < (size / 2)) ? color1 : color2);
+  }
+
+  SEGMENT_RUNTIME.counter_mode_step = (step + 1) % size;
+  return stepDelay(length);
+}
+
+/*
+ * Alternating color/white pixels running.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_running_color(void) {
+  return running(SEGMENT.colors[0], WHITE);
+}
+
+
+/*
+ * Alternating red/blue pixels running.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_running_red_blue(void) {
+  return running(RED, BLUE);
+}
+
+
+/*
+ * Alternating red/green pixels running.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_merry_christmas(void) {
+  return running(RED, GREEN);
+}
+
+/*
+ * Alternating orange/purple pixels running.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_halloween(void) {
+  return running(PURPLE, ORANGE);
+}
+
+
+/*
+ * Random colored pixels running.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_running_random(void) {
+  if(IS_REVERSE) {
+    copyPixels(SEGMENT.start, SEGMENT.start + 1, SEGMENT_LENGTH - 1);
+  } else {
+    copyPixels(SEGMENT.start + 1, SEGMENT.start, SEGMENT_LENGTH - 1);
+  }
+
+  if(SEGMENT_RUNTIME.counter_mode_step == 0) {
+    SEGMENT_RUNTIME.aux_param = get_random_wheel_index(SEGMENT_RUNTIME.aux_param);
+    if(IS_REVERSE) {
+      setPixelColor(SEGMENT.stop, palette_color(SEGMENT_RUNTIME.aux_param));
+    } else {
+      setPixelColor(SEGMENT.start, palette_color(SEGMENT_RUNTIME.aux_param));
+    }
+  }
+
+  SEGMENT_RUNTIME.counter_mode_step = (SEGMENT_RUNTIME.counter_mode_step + 1) % (2 << SIZE_OPTION);
+  return stepDelay(SEGMENT_LENGTH);
+}
+
+
+/*
+ * K.I.T.T.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_larson_scanner(void) {
+  fade_out();
+
+  if(SEGMENT_RUNTIME.counter_mode_step < SEGMENT_LENGTH) {
+    if(IS_REVERSE) {
+      setPixelColor(SEGMENT.stop - SEGMENT_RUNTIME.counter_mode_step, SEGMENT.colors[0]);
+    } else {
+      setPixelColor(SEGMENT.start + SEGMENT_RUNTIME.counter_mode_step, SEGMENT.colors[0]);
+    }
+  } else {
+    uint16_t index = (SEGMENT_LENGTH * 2) - SEGMENT_RUNTIME.counter_mode_step - 2;
+    if(IS_REVERSE) {
+      setPixelColor(SEGMENT.stop - index, SEGMENT.colors[0]);
+    } else {
+      setPixelColor(SEGMENT.start + index, SEGMENT.colors[0]);
+    }
+  }
+
+  if(SEGMENT_RUNTIME.counter_mode_step % SEGMENT_LENGTH == 0) SET_CYCLE;
+  else CLR_CYCLE;
+
+  SEGMENT_RUNTIME.counter_mode_step++;
+  if(SEGMENT_RUNTIME.counter_mode_step >= (uint16_t)((SEGMENT_LENGTH * 2) - 2)) {
+    SEGMENT_RUNTIME.counter_mode_step = 0;
+  }
+
+  return stepDelay(SEGMENT_LENGTH * 2);
+}
+
+
+/*
+ * Firing comets from one end.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_comet(void) {
+  fade_out();
+
+  if(IS_REVERSE) {
+    setPixelColor(SEGMENT.stop - SEGMENT_RUNTIME.counter_mode_step, SEGMENT.colors[0]);
+  } else {
+    setPixelColor(SEGMENT.start + SEGMENT_RUNTIME.counter_mode_step, SEGMENT.colors[0]);
+  }
+
+  SEGMENT_RUNTIME.counter_mode_step = (SEGMENT_RUNTIME.counter_mode_step + 1) % SEGMENT_LENGTH;
+  return stepDelay(SEGMENT_LENGTH);
+}
+
+
+/*
+ * Fireworks function.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::fireworks(uint32_t color) {
+  fade_out();
+
+// for better performance, manipulate the pixels[] array directly
+  uint8_t *pixels = (uint8_t*)_frame;
+  setDirty(SEGMENT.start, SEGMENT.stop);
+  uint8_t bytesPerPixel = getNumBytesPerPixel(); // 3=RGB, 4=RGBW
+  uint8_t* startPixel = pixels + (uint32_t)SEGMENT.start * bytesPerPixel + bytesPerPixel; // no 16 bit overflow on long strips
+  uint8_t* stopPixel = pixels + (uint32_t)SEGMENT.stop * bytesPerPixel;
+  for(uint8_t* p=startPixel; p < stopPixel; p++) {
+    uint16_t tmpPixel = (p[-bytesPerPixel] >> 2) +
+      p[0] +
+      (p[bytesPerPixel] >> 2);
+    p[0] =  tmpPixel > 255 ? 255 : tmpPixel;
+  }
+
+  uint8_t size = 2 << SIZE_OPTION;
+  if(!_triggered) {
+    for(uint16_t i=0; i<max(1, SEGMENT_LENGTH/20); i++) {
+      if(random8(10) == 0) {
+        uint16_t index = SEGMENT.start + random16(SEGMENT_LENGTH - size);
+        for(uint8_t j=0; j<size; j++) {
+          setPixelColor(index + j, color);
+        }
+      }
+    }
+  } else {
+    for(uint16_t i=0; i<max(1, SEGMENT_LENGTH/10); i++) {
+      uint16_t index = SEGMENT.start + random16(SEGMENT_LENGTH - size);
+      for(uint8_t j=0; j<size; j++) {
+        setPixelColor(index + j, color);
+      }
+    }
+  }
+  return (SEGMENT.speed / SEGMENT_LENGTH);
+}
+
+/*
+ * Firework sparks.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_fireworks(void) {
+  uint32_t color = BLACK;
+  do { // randomly choose a non-BLACK color from the colors array
+    color = SEGMENT.colors[random8(NumColors)];
+  } while (color == BLACK);
+  return fireworks(color);
+}
+
+/*
+ * Random colored firework sparks.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_fireworks_random(void) {
+  return fireworks(palette_color(random8()));
+}
+
+
+/*
+ * Fire flicker function
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::fire_flicker(int rev_intensity) {
+  byte w = (SEGMENT.colors[0] >> 24) & 0xFF;
+  byte g = (SEGMENT.colors[0] >> 16) & 0xFF;
+  byte r = (SEGMENT.colors[0] >>  8) & 0xFF;
+  byte b = (SEGMENT.colors[0]        & 0xFF);
+  byte lum = max(w, max(r, max(g, b))) / rev_intensity;
+  for(uint16_t i=SEGMENT.start; i <= SEGMENT.stop; i++) {
+    int flicker = random8(lum);
+    setPixelColor(i, max(r - flicker, 0), max(g - flicker, 0), max(b - flicker, 0), max(w - flicker, 0));
+  }
+  return (SEGMENT.speed / SEGMENT_LENGTH);
+}
+
+/*
+ * Random flickering.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_fire_flicker(void) {
+  return fire_flicker(3);
+}
+
+/*
+* Random flickering, less intensity.
+*/
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_fire_flicker_soft(void) {
+  return fire_flicker(6);
+}
+
+/*
+* Random flickering, more intensity.
+*/
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_fire_flicker_intense(void) {
+  return fire_flicker(1.7);
+}
+
+
+/*
+ * Tricolor chase function
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::tricolor_chase(uint32_t color1, uint32_t color2, uint32_t color3) {
+  DISPATCH_KERNEL(tricolor_chase_kernel, color1, color2, color3);
+}
+
+WS2812FX_TEMPLATE template<typename Opt>
+uint16_t WS2812FX_T::tricolor_chase_kernel(Opt o, uint32_t color1, uint32_t color2, uint32_t color3) {
+  uint16_t start = SEGMENT.start, stop = SEGMENT.stop, length = SEGMENT_LENGTH;
+  uint8_t sizeCnt = 1 << o.size();
+  uint16_t period = sizeCnt * 3;
+  uint16_t index = SEGMENT_RUNTIME.counter_mode_call % period;
+  for(uint16_t i=0; i < length && !RENDER_STATE.catch_up; i++, index++) {
+    if(index == period) index = 0;
+
+    uint32_t color = color3;
+    if(index < sizeCnt) color = color1;
+    else if(index < (sizeCnt * 2)) color = color2;
+
+    putPixel(o, o.reverse() ? start + i : stop - i, color);
+  }
+
+  return stepDelay(length);
+}
+
+
+/*
+ * Tricolor chase mode
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_tricolor_chase(void) {
+  return tricolor_chase(SEGMENT.colors[0], SEGMENT.colors[1], SEGMENT.colors[2]);
+}
+
+
+/*
+ * Alternating white/red/black pixels running.
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_circus_combustus(void) {
+  return tricolor_chase(RED, WHITE, BLACK);
+}
+
+/*
+ * ICU mode
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_icu(void) {
+  uint16_t dest = SEGMENT_RUNTIME.counter_mode_step & 0xFFFF;
+ 
+  setPixelColor(SEGMENT.start + dest, SEGMENT.colors[0]);
+  setPixelColor(SEGMENT.start + dest + SEGMENT_LENGTH/2, SEGMENT.colors[0]);
+
+  if(SEGMENT_RUNTIME.aux_param3 == dest) { // pause between eye movements
+    if(random8(6) == 0) { // blink once in a while
+      setPixelColor(SEGMENT.start + dest, BLACK);
+      setPixelColor(SEGMENT.start + dest + SEGMENT_LENGTH/2, BLACK);
+      return 200;
+    }
+    SEGMENT_RUNTIME.aux_param3 = random16(SEGMENT_LENGTH/2);
+    return 1000 + random16(2000);
+  }
+
+  setPixelColor(SEGMENT.start + dest, BLACK);
+  setPixelColor(SEGMENT.start + dest + SEGMENT_LENGTH/2, BLACK);
+
+  if(SEGMENT_RUNTIME.aux_param3 > SEGMENT_RUNTIME.counter_mode_step) {
+    SEGMENT_RUNTIME.counter_mode_step++;
+    dest++;
+  } else if (SEGMENT_RUNTIME.aux_param3 < SEGMENT_RUNTIME.counter_mode_step) {
+    SEGMENT_RUNTIME.counter_mode_step--;
+    dest--;
+  }
+
+  setPixelColor(SEGMENT.start + dest, SEGMENT.colors[0]);
+  setPixelColor(SEGMENT.start + dest + SEGMENT_LENGTH/2, SEGMENT.colors[0]);
+
+  return stepDelay(SEGMENT_LENGTH);
+}
+
+/*
+ * Custom modes, every custom mode id maps to this function
+ */
+WS2812FX_TEMPLATE
+uint16_t WS2812FX_T::mode_custom() {
+  uint8_t index = SEGMENT.mode - FX_MODE_CUSTOM_0;
+  if(index < _custom_modes.size()) {
+    custom_mode& cm = _custom_modes[index];
+    if(cm.timed_fn != NULL) {
+      uint16_t elapsed = advancePhase();
+      cm.timed_fn(cm.context, elapsed, SEGMENT_RUNTIME.counter_mode_step >> 16);
+      return getFrameInterval(RENDER_STATE.segment_index);
+    }
+    if(cm.fn != NULL) return cm.fn(cm.context);
+  }
+  return 1000; // empty slot
+}
+
+/*
+ * Custom mode helpers. A custom mode is a function plus a context pointer that
+ * is passed back to it on every call. Old style uint16_t (*)() effects are
+ * stored with a small trampoline.
+ */
+WS2812FX_TEMPLATE
+void WS2812FX_T::setCustomMode(uint16_t (*p)()) {
+  _custom_modes[0].fn = callNoContext;
+  _custom_modes[0].timed_fn = NULL;
+  _custom_modes[0].context = reinterpret_cast<void*>(p);
+  _custom_modes[0].flags = MODE_NO_FLAGS;
+}
+
+WS2812FX_TEMPLATE
+uint8_t WS2812FX_T::setCustomMode(const __FlashStringHelper* name, uint16_t (*p)()) {
+  return setCustomMode(name, callNoContext, reinterpret_cast<void*>(p));
+}
+
+WS2812FX_TEMPLATE
+uint8_t WS2812FX_T::setCustomMode(uint8_t index, const __FlashStringHelper* name, uint16_t (*p)()) {
+  return setCustomMode(index, name, callNoContext, reinterpret_cast<void*>(p));
+}
+
+// stores the custom mode in the first empty slot, adding a slot if there is none
+WS2812FX_TEMPLATE
+uint8_t WS2812FX_T::setCustomMode(const __FlashStringHelper* name, uint16_t (*p)(void*), void* context) {
+  uint8_t index = 0;
+  while(index < _custom_modes.size() && (_custom_modes[index].fn != NULL || _custom_modes[index].timed_fn != NULL)) index++;
+  return setCustomMode(index, name, p, context);
+}
+
+// returns the custom mode's mode id, or 0 if there is no memory left for it
+WS2812FX_TEMPLATE
+uint8_t WS2812FX_T::setCustomMode(uint8_t index, const __FlashStringHelper* name, uint16_t (*p)(void*), void* context) {
+  if(index >= MAX_CUSTOM_MODE_COUNT) return 0;
+  if(index >= _custom_modes.size() && !_custom_modes.resize(index + 1)) return 0;
+
+  _custom_modes[index].fn = p;
+  _custom_modes[index].timed_fn = NULL;
+  _custom_modes[index].context = context;
+  _custom_modes[index].name = name; // store the custom mode name
+  _custom_modes[index].flags = MODE_NO_FLAGS;
+  return (FX_MODE_CUSTOM_0 + index);
+}
+
+/*
+ * Timed custom modes get the ms since their last frame and the segment's phase
+ * instead of stepping once per call (see advancePhase()).
+ */
+WS2812FX_TEMPLATE
+uint8_t WS2812FX_T::setCustomMode(const __FlashStringHelper* name, void (*p)(uint16_t elapsed, uint16_t phase)) {
+  return setCustomMode(name, callTimedNoContext, reinterpret_cast<void*>(p));
+}
+
+WS2812FX_TEMPLATE
+uint8_t WS2812FX_T::setCustomMode(const __FlashStringHelper* name, timed_custom_fn p, void* context) {
+  uint8_t mode = setCustomMode(name, static_cast<uint16_t (*)(void*)>(NULL), context); // takes the first empty slot
+  if(mode != 0) {
+    _custom_modes[mode - FX_MODE_CUSTOM_0].timed_fn = p;
+    _custom_modes[mode - FX_MODE_CUSTOM_0].flags = MODE_TIMED;
+  }
+  return mode;
+}
+
+WS2812FX_TEMPLATE
+typename WS2812FX_T::Custom_modes& WS2812FX_T::Custom_modes::operator=(const Custom_modes& other) {
+  if(this != &other) {
+    _size = MaxCustomModes;
+    if(other._size > _capacity && !resize(other._size)) {
+      memset(_entries, 0, _size * sizeof(custom_mode)); // out of memory, start over empty
+      return *this;
+    }
+    memcpy(_entries, other._entries, other._size * sizeof(custom_mode));
+    _size = other._size;
+  }
+  return *this;
+}
+
+WS2812FX_TEMPLATE
+typename WS2812FX_T::Output_lut& WS2812FX_T::Output_lut::operator=(const Output_lut& other) {
+  if(this != &other) {
+    if(other._table == NULL) {
+      release();
+    } else {
+      if(_table == NULL) _table = (uint8_t*)malloc(512);
+      if(_table != NULL) memcpy(_table, other._table, 512);
+    }
+  }
+  return *this;
+}
+
+#if COMMAND_QUEUE_SIZE > 0
+WS2812FX_TEMPLATE
+void WS2812FX_T::Command_queue::clear(void) {
+  for(uint16_t i=0; i < COMMAND_QUEUE_SIZE; i++) {
+    _cells[i].seq = i;
+  }
+  _enqueue = 0;
+  _dequeue = 0;
+}
+
+// false if the queue is full
+WS2812FX_TEMPLATE
+boolean WS2812FX_T::Command_queue::push(const command& c) {
+#if defined(__AVR__)
+  uint8_t sreg = SREG;
+  cli();
+  uint16_t pos = _enqueue;
+  Cell& cell = _cells[pos & (COMMAND_QUEUE_SIZE - 1)];
+  boolean free = cell.seq == pos;
+  if(free) {
+    cell.cmd = c;
+    cell.seq = pos + 1;
+    _enqueue = pos + 1;
+  }
+  SREG = sreg;
+  return free;
+#else
+  uint16_t pos = _enqueue.load(std::memory_order_relaxed);
+  Cell* cell;
+  while(true) {
+    cell = &_cells[pos & (COMMAND_QUEUE_SIZE - 1)];
+    int16_t diff = (int16_t)(uint16_t)(cell->seq.load(std::memory_order_acquire) - pos);
+    if(diff == 0) { // the cell is free, claim it
+      if(_enqueue.compare_exchange_weak(pos, (uint16_t)(pos + 1), std::memory_order_relaxed)) break;
+    } else if(diff < 0) { // the consumer hasn't emptied the cell yet
+      return false;
+    } else { // another producer claimed the cell
+      pos = _enqueue.load(std::memory_order_relaxed);
+    }
+  }
+  cell->cmd = c;
+  cell->seq.store(pos + 1, std::memory_order_release);
+  return true;
+#endif
+}
+
+// false if the queue is empty
+WS2812FX_TEMPLATE
+boolean WS2812FX_T::Command_queue::pop(command& c) {
+#if defined(__AVR__)
+  uint8_t sreg = SREG;
+  cli();
+  Cell& cell = _cells[_dequeue & (COMMAND_QUEUE_SIZE - 1)];
+  boolean full = cell.seq == (uint16_t)(_dequeue + 1);
+  if(full) {
+    c = cell.cmd;
+    cell.seq = _dequeue + COMMAND_QUEUE_SIZE;
+    _dequeue++;
+  }
+  SREG = sreg;
+  return full;
+#else
+  Cell& cell = _cells[_dequeue & (COMMAND_QUEUE_SIZE - 1)];
+  if(cell.seq.load(std::memory_order_acquire) != (uint16_t)(_dequeue + 1)) return false;
+  c = cell.cmd;
+  cell.seq.store(_dequeue + COMMAND_QUEUE_SIZE, std::memory_order_release);
+  _dequeue++;
+  return true;
+#endif
+}
+#endif
+
+WS2812FX_TEMPLATE
+typename WS2812FX_T::scene_config* WS2812FX_T::Scene_slot::claim(void) {
+#if defined(__AVR__)
+  uint8_t sreg = SREG;
+  cli();
+  boolean free = _state == SLOT_FREE;
+  if(free) _state = SLOT_FILLING;
+  SREG = sreg;
+  if(!free) return NULL;
+#else
+  uint8_t expected = SLOT_FREE;
+  if(!_state.compare_exchange_strong(expected, (uint8_t)SLOT_FILLING)) return NULL;
+#endif
+  if(_scene == NULL) _scene = (scene_config*)malloc(sizeof(scene_config));
+  if(_scene == NULL) _state = SLOT_FREE;
+  return _scene;
+}
+
+// same rounding as FastLED's scale8(), so full brightness leaves the values alone
+WS2812FX_TEMPLATE
+boolean WS2812FX_T::Output_lut::build(uint8_t brightness) {
+  if(_table == NULL) _table = (uint8_t*)malloc(512);
+  if(_table == NULL) return false;
+  for(uint16_t i=0; i < 256; i++) {
+    _table[i]       = (i * (1 + brightness)) >> 8;
+    _table[256 + i] = (gamma8(i) * (1 + brightness)) >> 8;
+  }
+  return true;
+}
+
+WS2812FX_TEMPLATE
+boolean WS2812FX_T::Custom_modes::resize(uint8_t n) {
+  if(n > _capacity) {
+    uint16_t capacity = max((uint16_t)(_capacity * 2), (uint16_t)n);
+    capacity = min(capacity, (uint16_t)MAX_CUSTOM_MODE_COUNT);
+    custom_mode* entries = (_entries == _slots) ?
+      (custom_mode*)malloc(capacity * sizeof(custom_mode)) :
+      (custom_mode*)realloc(_entries, capacity * sizeof(custom_mode));
+    if(entries == NULL) return false;
+    if(_entries == _slots) memcpy(entries, _slots, _size * sizeof(custom_mode));
+    _entries = entries;
+    _capacity = capacity;
+  }
+  if(n > _size) memset(&_entries[_size], 0, (n - _size) * sizeof(custom_mode));
+  _size = n;
+  return true;
+}
+
+/*
+ * Custom show helper
+ */
+WS2812FX_TEMPLATE
+void WS2812FX_T::setCustomShow(void (*p)()) {
+  customShow = p;
+  customShowBusy = NULL;
+  _last_frame_valid = false; // the new output hasn't shown anything yet
+}
+
+/*
+ * Asynchronous custom show helper. p() starts sending a frame and returns
+ * right away, busy() returns true until that frame has been sent. p() must
+ * latch (copy or convert) the pixel data before it returns, since the next
+ * frame may be rendered while the previous one is still on the wire.
+ */
+WS2812FX_TEMPLATE
+void WS2812FX_T::setCustomShow(void (*p)(), boolean (*busy)()) {
+  customShow = p;
+  customShowBusy = busy;
+  _last_frame_valid = false;
+}
+
+#undef DISPATCH_KERNEL
+#undef KERNEL_CASES
+#undef KERNEL_CASE
+#undef WS2812FX_TEMPLATE
+#undef WS2812FX_T
+
+#endif
@@ -44,11 +44,16 @@
 extern WS2812FX ws2812fx;
 void beatIt(WS2812FX::Segment*, uint8_t);
 
-uint16_t heartbeat(void) {
-  static unsigned long lastBeat = 0;
-  static bool secondBeatActive = false;
+typedef struct Heartbeat_state { // kept in the segment's scratch memory
+  unsigned long lastBeat;
+  bool secondBeatActive;
+} heartbeat_state;
 
+uint16_t heartbeat(void) {
   WS2812FX::Segment* seg = ws2812fx.getSegment(); // get the current segment
+  heartbeat_state* state = (heartbeat_state*)ws2812fx.getScratch(sizeof(heartbeat_state));
+  if(state == NULL) return seg->speed; // not enough scratch memory (see SCRATCH_SIZE)
+
   int seglen = seg->stop - seg->start + 1;
 
   // Get and translate the segment's size option
@@ -60,18 +65,19 @@ uint16_t heartbeat(void) {
   uint16_t byteCount = centerOffset - bytesPerPixelBlock;
   memmove(ws2812fx.getPixels(), ws2812fx.getPixels() + bytesPerPixelBlock, byteCount);
   memmove(ws2812fx.getPixels() + centerOffset + bytesPerPixelBlock, ws2812fx.getPixels() + centerOffset, byteCount);
+  ws2812fx.setDirty(0, seglen - 1); // the pixel data was changed directly
 
   ws2812fx.fade_out();
 
-  unsigned long beatTimer = millis() - lastBeat;
-  if((beatTimer > SECOND_BEAT) && !secondBeatActive) { // time for the second beat?
+  unsigned long beatTimer = millis() - state->lastBeat;
+  if((beatTimer > SECOND_BEAT) && !state->secondBeatActive) { // time for the second beat?
     beatIt(seg, size); // create the second beat
-    secondBeatActive = true;
+    state->secondBeatActive = true;
   }
   if(beatTimer > MS_PER_BEAT) { // time to reset the beat timer?
     beatIt(seg, size); // create the first beat
-    secondBeatActive = false;
-    lastBeat = millis();
+    state->secondBeatActive = false;
+    state->lastBeat = millis();
   }
 
   return(seg->speed / 32);
@@ -38,6 +38,13 @@
 
 extern WS2812FX ws2812fx;
 
+#define NUM_COMETS 6
+
+typedef struct MultiComet_state { // kept in the segment's scratch memory
+  int16_t comets[NUM_COMETS];
+  bool initialized;
+} multiComet_state;
+
 uint16_t multiComet(void) {
   WS2812FX::Segment* seg = ws2812fx.getSegment(); // get the current segment
   int seglen = seg->stop - seg->start + 1;
@@ -46,10 +53,15 @@ uint16_t multiComet(void) {
 
   ws2812fx.fade_out();
 
-  static int16_t comets[] = {UINT16_MAX, UINT16_MAX, UINT16_MAX, UINT16_MAX, UINT16_MAX, UINT16_MAX};
-  static int8_t numComets = sizeof(comets)/sizeof(comets[0]);
+  multiComet_state* state = (multiComet_state*)ws2812fx.getScratch(sizeof(multiComet_state));
+  if(state == NULL) return seg->speed; // not enough scratch memory (see SCRATCH_SIZE)
+  int16_t* comets = state->comets;
+  if(!state->initialized) {
+    for(uint8_t i=0; i < NUM_COMETS; i++) comets[i] = INT16_MAX; // all comets idle
+    state->initialized = true;
+  }
 
-  for(uint8_t i=0; i < numComets; i++) {
+  for(uint8_t i=0; i < NUM_COMETS; i++) {
     if(comets[i] < seglen) {
       if(isReverse) {
         ws2812fx.setPixelColor(seg->stop - comets[i],  i % 2 ? seg->colors[0] : seg->colors[2]);
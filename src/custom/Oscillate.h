@@ -45,17 +45,29 @@ typedef struct Oscillator {
   int8_t  speed;
 } oscillator;
 
+typedef struct Oscillate_state { // kept in the segment's scratch memory
+  oscillator oscillators[NUM_COLORS];
+  bool initialized;
+} oscillate_state;
+
 uint16_t oscillate(void) {
   WS2812FX::Segment* seg = ws2812fx.getSegment(); // get the current segment
   int seglen = seg->stop - seg->start + 1;
 
-  static oscillator oscillators[NUM_COLORS] = {
-    {seglen/4,   seglen/8,  1, 1},
-    {seglen/4*2, seglen/8, -1, 1},
-    {seglen/4*3, seglen/8,  1, 2}
-  };
+  oscillate_state* state = (oscillate_state*)ws2812fx.getScratch(sizeof(oscillate_state));
+  if(state == NULL) return seg->speed; // not enough scratch memory (see SCRATCH_SIZE)
+  oscillator* oscillators = state->oscillators;
+  if(!state->initialized) {
+    const oscillator init[] = {
+      {(int16_t)(seglen/4),   (int8_t)(seglen/8),  1, 1},
+      {(int16_t)(seglen/4*2), (int8_t)(seglen/8), -1, 1},
+      {(int16_t)(seglen/4*3), (int8_t)(seglen/8),  1, 2}
+    };
+    memcpy(oscillators, init, sizeof(init));
+    state->initialized = true;
+  }
 
-  for(int8_t i=0; i < sizeof(oscillators)/sizeof(oscillators[0]); i++) {
+  for(int8_t i=0; i < NUM_COLORS; i++) {
     oscillators[i].pos += oscillators[i].dir * oscillators[i].speed;
     if((oscillators[i].dir == -1) && (oscillators[i].pos <= 0)) {
       oscillators[i].pos = 0;
@@ -71,7 +83,7 @@ uint16_t oscillate(void) {
 
   for(int16_t i=0; i < seglen; i++) {
     uint32_t color = BLACK;
-    for(int8_t j=0; j < sizeof(oscillators)/sizeof(oscillators[0]); j++) {
+    for(int8_t j=0; j < NUM_COLORS; j++) {
       if(i >= oscillators[j].pos - oscillators[j].size && i <= oscillators[j].pos + oscillators[j].size) {
         color = (color == BLACK) ? seg->colors[j] : ws2812fx.color_blend(color, seg->colors[j], 128);
       }
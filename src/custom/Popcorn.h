@@ -49,6 +49,11 @@ typedef struct Kernel {
   int32_t color;
 } kernel;
 
+typedef struct Popcorn_state { // kept in the segment's scratch memory
+  kernel popcorn[MAX_NUM_POPCORN];
+  float coeff;
+} popcorn_state;
+
 uint16_t popcorn(void) {
   WS2812FX::Segment* seg = ws2812fx.getSegment(); // get the current segment
   uint16_t seglen = seg->stop - seg->start + 1;
@@ -57,11 +62,13 @@ uint16_t popcorn(void) {
   if(popcornColor == bgColor) popcornColor = ws2812fx.color_wheel(ws2812fx.random8());
   bool isReverse = (seg->options & REVERSE) != 0;
 
-  static kernel popcorn[MAX_NUM_POPCORN];
-  static float coeff = 0.0f;
-  if(coeff == 0.0f) { // calculate the velocity coeff once (the secret sauce)
-    coeff = pow((float)seglen, 0.5223324f) * 0.3944296f;
+  popcorn_state* state = (popcorn_state*)ws2812fx.getScratch(sizeof(popcorn_state));
+  if(state == NULL) return seg->speed; // not enough scratch memory (see SCRATCH_SIZE)
+  kernel* popcorn = state->popcorn;
+  if(state->coeff == 0.0f) { // calculate the velocity coeff once (the secret sauce)
+    state->coeff = pow((float)seglen, 0.5223324f) * 0.3944296f;
   }
+  float coeff = state->coeff;
 
   // reset all LEDs to background color
   for(uint16_t i=seg->start; i <= seg->stop; i++) {
@@ -1,7 +1,6 @@
 /*
   An implementation of Mark Kriegsman's TwinkleFOX effect
   (https://gist.github.com/kriegsman/756ea6dcae8e30845b5a)
-  This implementation does not use the FastLED library.
 
   Colors[1] is the background color.
   If colors[0] is black, rainbow colors will be used, otherwise use colors[0].
@@ -39,10 +38,14 @@
 
 extern WS2812FX ws2812fx;
 
+#define TWINKLEFOX_CHUNK 16 // pixels blended per blendSpans() call
+
 uint16_t twinkleFox(void) {
   uint16_t mySeed = 0; // reset the random number generator seed
   WS2812FX::Segment* seg = ws2812fx.getSegment(); // get the current segment
   WS2812FX::Segment_runtime* segrt = ws2812fx.getSegmentRuntime();
+  uint8_t segIndex = ws2812fx.getSegmentIndex();
+  uint16_t seglen = seg->stop - seg->start + 1;
 
   // Get and translate the segment's size option
   uint8_t size = 1 << ((seg->options >> 1) & 0x03); // 1,2,4,8
@@ -51,42 +54,55 @@ uint16_t twinkleFox(void) {
   uint32_t color0 = seg->colors[0];
   uint32_t color1 = seg->colors[1];
   uint32_t color2 = seg->colors[2];
-  uint32_t blendedColor;
+  uint32_t fromColor = BLACK;
+  uint8_t blendAmt = 0;
 
-  for (uint16_t i = seg->start; i <= seg->stop; i+=size) {
-    // Use Mark Kriegsman's clever idea of using pseudo-random numbers to determine
-    // each LED's initial and increment blend values
-    mySeed = (mySeed * 2053) + 13849; // a random, but deterministic, number
-    uint16_t initValue = (mySeed + (mySeed >> 8)) & 0xff; // the LED's initial blend index (0-255)
-    mySeed = (mySeed * 2053) + 13849; // another random, but deterministic, number
-    uint16_t incrValue = (((mySeed + (mySeed >> 8)) & 0x07) + 1) * 2; // blend index increment (2,4,6,8,10,12,14,16)
+  // The LEDs are blended towards colors[1] a chunk at a time and each chunk is
+  // written to the segment in one go
+  uint32_t colors[TWINKLEFOX_CHUNK], background[TWINKLEFOX_CHUNK];
+  uint8_t amounts[TWINKLEFOX_CHUNK];
+  for(uint8_t j=0; j<TWINKLEFOX_CHUNK; j++) background[j] = color1;
+  uint8_t n = 0;
 
-    // We're going to use a sine function to blend colors, instead of Mark's triangle
-    // function, simply because a sine lookup table is already built into the
-    // Adafruit_NeoPixel lib. Yes, I'm lazy.
-    // Use the counter_mode_call var as a clock "tick" counter and calc the blend index
-    uint8_t blendIndex = (initValue + (segrt->counter_mode_call * incrValue)) & 0xff; // 0-255
-    // Index into the built-in Adafruit_NeoPixel sine table to lookup the blend amount
-    uint8_t blendAmt = Adafruit_NeoPixel::sine8(blendIndex); // 0-255
+  for (uint16_t i = 0; i < seglen; i++) {
+    // Each group of SIZE LEDs shares a color
+    if((i & (size - 1)) == 0) {
+      // Use Mark Kriegsman's clever idea of using pseudo-random numbers to determine
+      // each LED's initial and increment blend values
+      mySeed = (mySeed * 2053) + 13849; // a random, but deterministic, number
+      uint16_t initValue = (mySeed + (mySeed >> 8)) & 0xff; // the LED's initial blend index (0-255)
+      mySeed = (mySeed * 2053) + 13849; // another random, but deterministic, number
+      uint16_t incrValue = (((mySeed + (mySeed >> 8)) & 0x07) + 1) * 2; // blend index increment (2,4,6,8,10,12,14,16)
 
-    // If colors[0] is BLACK, bland random colors
-    if(color0 == BLACK) {
-      blendedColor = ws2812fx.color_blend(ws2812fx.color_wheel(initValue), color1, blendAmt);
-    // If colors[2] isn't BLACK, choose to blend colors[0]/colors[1] or colors[1]/colors[2]
-    // (which color pair to blend is picked randomly)
-    } else if((color2 != BLACK) && (initValue < 128) == 0) {
-      blendedColor = ws2812fx.color_blend(color2, color1, blendAmt);
-    // Otherwise always blend colors[0]/colors[1]
-    } else {
-      blendedColor = ws2812fx.color_blend(color0, color1, blendAmt);
-    }
+      // We're going to use a sine function to blend colors, instead of Mark's triangle
+      // function, simply because a sine lookup table is already built into the
+      // FastLED lib. Yes, I'm lazy.
+      // Use the counter_mode_call var as a clock "tick" counter and calc the blend index
+      uint8_t blendIndex = (initValue + (segrt->counter_mode_call * incrValue)) & 0xff; // 0-255
+      // Index into the built-in FastLED sine table to lookup the blend amount
+      blendAmt = sin8(blendIndex); // 0-255
 
-    // Assign the new color to the number of LEDs specified by the SIZE option
-    for(uint8_t j=0; j<size; j++) {
-      if((i + j) <= seg->stop) {
-        ws2812fx.setPixelColor(i + j, blendedColor);
+      // If colors[0] is BLACK, bland random colors
+      if(color0 == BLACK) {
+        fromColor = ws2812fx.color_wheel(initValue);
+      // If colors[2] isn't BLACK, choose to blend colors[0]/colors[1] or colors[1]/colors[2]
+      // (which color pair to blend is picked randomly)
+      } else if((color2 != BLACK) && (initValue < 128) == 0) {
+        fromColor = color2;
+      // Otherwise always blend colors[0]/colors[1]
+      } else {
+        fromColor = color0;
       }
     }
+
+    colors[n] = fromColor;
+    amounts[n] = blendAmt;
+    n++;
+    if(n == TWINKLEFOX_CHUNK || i == seglen - 1) {
+      ws2812fx.blendSpans(colors, colors, background, amounts, n);
+      ws2812fx.writeSpan(segIndex, i + 1 - n, colors, n);
+      n = 0;
+    }
   }
   return seg->speed / 32;
 }